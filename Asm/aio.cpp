@@ -0,0 +1,518 @@
+#include "aio.h"
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <set>
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#ifdef VM_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <sys/epoll.h>
+#endif
+
+using namespace std;
+
+#ifdef VM_IO_URING
+// ֱϵͳio_uring, liburing
+class Uring : public AsyncIO{
+	int RING = -1;
+	BYTE *SQ = nullptr, *CQ = nullptr;
+	size_t SQLEN = 0, CQLEN = 0, SQESLEN = 0;
+	io_uring_sqe *SQES = nullptr;
+	io_uring_cqe *CQES = nullptr;
+	unsigned *SHEAD, *STAIL, *SMASK, *SARRAY;
+	unsigned *CHEAD, *CTAIL, *CMASK;
+	unsigned ENTRIES = 0;
+	int EVENT = -1;				// עᵽϵeventfd, ÿһ1
+	mutex ARM;
+	DEVICE_WAKE WAKE = nullptr;	// armǼǵ֪ͨ, һκ
+	void *WARG = nullptr;
+public:
+	bool setup();
+	~Uring();
+	bool submit(bool WRITE, int FD, BYTE *BUF, size_t SIZE, long long OFFSET, int TAG);
+	bool complete(int &TAG, long long &RESULT, bool WAIT);
+	void arm(DEVICE_WAKE WAKE, void *ARG);
+	void fire();
+};
+
+// лeventfdͬһepoll, һ̵߳ȴת֪ͨ; ǼһԵ(EPOLLONESHOT)
+// epoll_waitȡصһ¼Ļ: תLOCK½ֻתLIVEеĻ,
+// ʱLOCKƳLIVE, ֮Ӧ; POOLһⲻ
+struct REACTOR{
+	int EP = -1;
+	mutex LOCK;
+	set<Uring*> LIVE;
+};
+static REACTOR *reactor(){
+	static REACTOR *R = new REACTOR();
+	static once_flag START;
+	call_once(START, []{
+		R->EP = epoll_create1(EPOLL_CLOEXEC);
+		if (R->EP < 0) return;
+		thread([]{
+			epoll_event E[64];
+			for (;;){
+				int N = epoll_wait(R->EP, E, 64, -1);
+				lock_guard<mutex> guard(R->LOCK);
+				for (int i = 0; i < N; i++){
+					Uring *U = (Uring*)E[i].data.ptr;
+					if (R->LIVE.count(U)) U->fire();
+				}
+			}
+		}).detach();
+	});
+	return R;
+}
+
+// Ҫں֧IORING_OP_READ/WRITEͰǰλöд(5.6), ˻ص̳߳
+bool Uring::setup(){
+	io_uring_params P;
+	memset(&P, 0, sizeof(P));
+	RING = (int)syscall(__NR_io_uring_setup, AIO_DEPTH, &P);
+	if (RING < 0 || !(P.features & IORING_FEAT_RW_CUR_POS)) return false;
+	ENTRIES = P.sq_entries;
+	SQLEN = P.sq_off.array + P.sq_entries * sizeof(unsigned);
+	CQLEN = P.cq_off.cqes + P.cq_entries * sizeof(io_uring_cqe);
+	bool SINGLE = (P.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (SINGLE){
+		SQLEN = CQLEN = SQLEN > CQLEN ? SQLEN : CQLEN;
+	}
+	void *M = mmap(NULL, SQLEN, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, RING, IORING_OFF_SQ_RING);
+	if (M == MAP_FAILED) return false;
+	SQ = (BYTE*)M;
+	if (SINGLE){
+		CQ = SQ;
+	}else{
+		M = mmap(NULL, CQLEN, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, RING, IORING_OFF_CQ_RING);
+		if (M == MAP_FAILED) return false;
+		CQ = (BYTE*)M;
+	}
+	SQESLEN = P.sq_entries * sizeof(io_uring_sqe);
+	M = mmap(NULL, SQESLEN, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, RING, IORING_OFF_SQES);
+	if (M == MAP_FAILED) return false;
+	SQES = (io_uring_sqe*)M;
+	SHEAD = (unsigned*)(SQ + P.sq_off.head);
+	STAIL = (unsigned*)(SQ + P.sq_off.tail);
+	SMASK = (unsigned*)(SQ + P.sq_off.ring_mask);
+	SARRAY = (unsigned*)(SQ + P.sq_off.array);
+	CHEAD = (unsigned*)(CQ + P.cq_off.head);
+	CTAIL = (unsigned*)(CQ + P.cq_off.tail);
+	CMASK = (unsigned*)(CQ + P.cq_off.ring_mask);
+	CQES = (io_uring_cqe*)(CQ + P.cq_off.cqes);
+	EVENT = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	REACTOR *R = reactor();
+	if (EVENT < 0 || R->EP < 0) return false;
+	{
+		lock_guard<mutex> guard(R->LOCK);
+		R->LIVE.insert(this);
+	}
+	epoll_event E;
+	E.events = 0;
+	E.data.ptr = this;
+	return syscall(__NR_io_uring_register, RING, IORING_REGISTER_EVENTFD, &EVENT, 1) == 0 &&
+		epoll_ctl(R->EP, EPOLL_CTL_ADD, EVENT, &E) == 0;
+}
+
+// ƳLIVEʱӦתһ¼, ת
+Uring::~Uring(){
+	REACTOR *R = reactor();
+	{
+		lock_guard<mutex> guard(R->LOCK);
+		R->LIVE.erase(this);
+	}
+	if (EVENT >= 0){
+		if (R->EP >= 0) epoll_ctl(R->EP, EPOLL_CTL_DEL, EVENT, NULL);
+		close(EVENT);
+	}
+	if (SQES) munmap(SQES, SQESLEN);
+	if (CQ && CQ != SQ) munmap(CQ, CQLEN);
+	if (SQ) munmap(SQ, SQLEN);
+	if (RING >= 0) close(RING);
+}
+
+bool Uring::submit(bool WRITE, int FD, BYTE *BUF, size_t SIZE, long long OFFSET, int TAG){
+	unsigned TAIL = *STAIL;
+	if (TAIL - __atomic_load_n(SHEAD, __ATOMIC_ACQUIRE) >= ENTRIES) return false;
+	unsigned INDEX = TAIL & *SMASK;
+	io_uring_sqe *E = &SQES[INDEX];
+	memset(E, 0, sizeof(*E));
+	E->opcode = WRITE ? IORING_OP_WRITE : IORING_OP_READ;
+	E->fd = FD;
+	E->addr = (unsigned long long)BUF;
+	E->len = (unsigned)SIZE;
+	E->off = (unsigned long long)OFFSET;
+	E->user_data = (unsigned long long)TAG;
+	SARRAY[INDEX] = INDEX;
+	__atomic_store_n(STAIL, TAIL + 1, __ATOMIC_RELEASE);
+	for (;;){
+		int N = (int)syscall(__NR_io_uring_enter, RING, 1, 0, 0, NULL, 0);
+		if (N == 1) return true;
+		if (N >= 0 || (errno != EINTR && errno != EAGAIN && errno != EBUSY)) break;
+		this_thread::yield();
+	}
+	// ʧʱںûȡ߾ͳ, ´ύ󽻳ȥ; ȡߵճ
+	if (__atomic_load_n(SHEAD, __ATOMIC_ACQUIRE) != TAIL) return true;
+	__atomic_store_n(STAIL, TAIL, __ATOMIC_RELEASE);
+	return false;
+}
+
+bool Uring::complete(int &TAG, long long &RESULT, bool WAIT){
+	for (;;){
+		unsigned HEAD = *CHEAD;
+		if (HEAD != __atomic_load_n(CTAIL, __ATOMIC_ACQUIRE)){
+			io_uring_cqe *E = &CQES[HEAD & *CMASK];
+			TAG = (int)E->user_data;
+			RESULT = E->res;
+			__atomic_store_n(CHEAD, HEAD + 1, __ATOMIC_RELEASE);
+			return true;
+		}
+		if (!WAIT) return false;
+		if (syscall(__NR_io_uring_enter, RING, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR){
+			return false;
+		}
+	}
+}
+
+// eventfdϻ۵ľɼٵǼ, Ǽ֮żе, ߶ܴ, WAKEֻȡһαֻ֤֪ͨһ
+void Uring::arm(DEVICE_WAKE WAKE, void *ARG){
+	{
+		lock_guard<mutex> guard(ARM);
+		this->WAKE = WAKE;
+		WARG = ARG;
+	}
+	unsigned long long N;
+	while (::read(EVENT, &N, sizeof(N)) > 0);
+	epoll_event E;
+	E.events = EPOLLIN | EPOLLONESHOT;
+	E.data.ptr = this;
+	epoll_ctl(reactor()->EP, EPOLL_CTL_MOD, EVENT, &E);
+	if (*CHEAD != __atomic_load_n(CTAIL, __ATOMIC_ACQUIRE)) fire();
+}
+
+void Uring::fire(){
+	DEVICE_WAKE F;
+	void *ARG;
+	{
+		lock_guard<mutex> guard(ARM);
+		F = WAKE;
+		ARG = WARG;
+		WAKE = nullptr;
+	}
+	if (F) F(ARG);
+}
+#endif
+
+// ̳߳: 豸AIO_THREADSִ߳Ķд, ŻظԵɶ
+class Pool;
+
+struct AIO_REQ{
+	Pool *OWNER;
+	bool WRITE;
+	int FD;
+	BYTE *BUF;
+	size_t SIZE;
+	long long OFFSET;
+	int TAG;
+	long long RESULT;
+};
+
+class Pool : public AsyncIO{
+	mutex LOCK;
+	condition_variable SIGNAL;
+	deque<AIO_REQ> DONE;
+	DEVICE_WAKE WAKE = nullptr;	// armǼǵ֪ͨ, һκ
+	void *WARG = nullptr;
+public:
+	bool submit(bool WRITE, int FD, BYTE *BUF, size_t SIZE, long long OFFSET, int TAG);
+	bool complete(int &TAG, long long &RESULT, bool WAIT);
+	void arm(DEVICE_WAKE WAKE, void *ARG);
+	// ڹ߳ϵ, ֪ͨڷſ֮󷢳
+	void finish(const AIO_REQ &R){
+		DEVICE_WAKE F;
+		void *ARG;
+		{
+			lock_guard<mutex> guard(LOCK);
+			DONE.push_back(R);
+			SIGNAL.notify_one();
+			F = WAKE;
+			ARG = WARG;
+			WAKE = nullptr;
+		}
+		if (F) F(ARG);
+	}
+};
+
+// ִе; ߳Ƿ, ⲻ, ˳ʱ߳ڵȵῨס
+struct POOL_STATE{
+	mutex LOCK;
+	condition_variable SIGNAL;
+	deque<AIO_REQ> TODO;
+};
+static POOL_STATE *POOL = new POOL_STATE();
+
+static long long transfer(const AIO_REQ &R){
+#ifdef _WIN32
+	HANDLE H = (HANDLE)_get_osfhandle(R.FD);
+	OVERLAPPED O;
+	memset(&O, 0, sizeof(O));
+	O.Offset = (DWORD)R.OFFSET;
+	O.OffsetHigh = (DWORD)(R.OFFSET >> 32);
+	DWORD N = 0;
+	BOOL OK = R.WRITE ? WriteFile(H, R.BUF, (DWORD)R.SIZE, &N, R.OFFSET < 0 ? NULL : &O)
+		: ReadFile(H, R.BUF, (DWORD)R.SIZE, &N, R.OFFSET < 0 ? NULL : &O);
+	return OK || GetLastError() == ERROR_HANDLE_EOF ? (long long)N : -1;
+#else
+	ssize_t N;
+	if (R.OFFSET < 0){
+		N = R.WRITE ? ::write(R.FD, R.BUF, R.SIZE) : ::read(R.FD, R.BUF, R.SIZE);
+	}else{
+		N = R.WRITE ? pwrite(R.FD, R.BUF, R.SIZE, R.OFFSET) : pread(R.FD, R.BUF, R.SIZE, R.OFFSET);
+	}
+	return N < 0 ? -errno : N;
+#endif
+}
+
+static void pool_worker(){
+	for (;;){
+		unique_lock<mutex> guard(POOL->LOCK);
+		POOL->SIGNAL.wait(guard, []{ return !POOL->TODO.empty(); });
+		AIO_REQ R = POOL->TODO.front();
+		POOL->TODO.pop_front();
+		guard.unlock();
+		R.RESULT = transfer(R);
+		R.OWNER->finish(R);
+	}
+}
+
+// ߳ڵһύʱ, ˳
+bool Pool::submit(bool WRITE, int FD, BYTE *BUF, size_t SIZE, long long OFFSET, int TAG){
+	static once_flag START;
+	call_once(START, []{
+		for (int i = 0; i < AIO_THREADS; i++){
+			thread(pool_worker).detach();
+		}
+	});
+	AIO_REQ R = { this, WRITE, FD, BUF, SIZE, OFFSET, TAG, 0 };
+	lock_guard<mutex> guard(POOL->LOCK);
+	POOL->TODO.push_back(R);
+	POOL->SIGNAL.notify_one();
+	return true;
+}
+
+bool Pool::complete(int &TAG, long long &RESULT, bool WAIT){
+	unique_lock<mutex> guard(LOCK);
+	if (WAIT){
+		SIGNAL.wait(guard, [this]{ return !DONE.empty(); });
+	}else if (DONE.empty()){
+		return false;
+	}
+	TAG = DONE.front().TAG;
+	RESULT = DONE.front().RESULT;
+	DONE.pop_front();
+	return true;
+}
+
+void Pool::arm(DEVICE_WAKE WAKE, void *ARG){
+	{
+		lock_guard<mutex> guard(LOCK);
+		if (DONE.empty()){
+			this->WAKE = WAKE;
+			WARG = ARG;
+			return;
+		}
+	}
+	WAKE(ARG);
+}
+
+AsyncIO *AsyncIO::create(){
+#ifdef VM_IO_URING
+	Uring *U = new Uring();
+	if (U->setup()) return U;
+	delete U;
+#endif
+	return new Pool();
+}
+
+// mode: "r", "w"ضд, "a"׷д
+static int aio_open(const char *path, const char *mode){
+	int FLAGS = mode[0] == 'r' ? O_RDONLY : mode[0] == 'a' ? O_WRONLY | O_CREAT | O_APPEND : O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef _WIN32
+	return _open(path, FLAGS | _O_BINARY, 0644);
+#else
+	return open(path, FLAGS, 0644);
+#endif
+}
+
+AsyncDevice::AsyncDevice(const char *path, const char *mode) : AsyncDevice(aio_open(path, mode), true){
+	if (FD < 0){
+		printf("can't open device %s\n", path);
+		return;
+	}
+	STREAM = STREAM || mode[0] == 'a';
+}
+
+// ܶλFD(ܵ/ն)ǰλöд, ӵǰλÿʼƫƶд
+AsyncDevice::AsyncDevice(int fd, bool own) : IO(AsyncIO::create()), FD(fd), OWN(own){
+	RBUF = new BYTE[AIO_BUFFER];
+	FILL = new BYTE[AIO_BUFFER];
+	WBUF = new BYTE[AIO_BUFFER];
+#ifdef _WIN32
+	long long POS = FD < 0 ? -1 : _lseeki64(FD, 0, SEEK_CUR);
+#else
+	long long POS = FD < 0 ? -1 : lseek(FD, 0, SEEK_CUR);
+#endif
+	STREAM = POS < 0;
+	ROFF = WOFF = POS < 0 ? 0 : POS;
+	REND = WERR = FD < 0;
+}
+
+// ;ȫɺͷŻ
+AsyncDevice::~AsyncDevice(){
+	flush();
+	while (RBUSY || WBUSY){
+		poll(true);
+	}
+	delete IO;
+	if (OWN && FD >= 0){
+#ifdef _WIN32
+		_close(FD);
+#else
+		close(FD);
+#endif
+	}
+	delete[] RBUF;
+	delete[] FILL;
+	delete[] WBUF;
+}
+
+// ȡɵ, WAITΪtrueʱٵȵһ
+void AsyncDevice::poll(bool WAIT){
+	int TAG;
+	long long RESULT;
+	while ((RBUSY || WBUSY) && IO->complete(TAG, RESULT, WAIT)){
+		WAIT = false;
+		if (TAG == 'r'){
+			RBUSY = false;
+			if (RESULT <= 0){
+				REND = true;
+			}else{
+				RTAIL += (size_t)RESULT;
+				ROFF += RESULT;
+			}
+		}else if (RESULT <= 0){
+			WBUSY = false;
+			WERR = true;
+		}else{
+			// дһʱдʣµ
+			WDONE += (size_t)RESULT;
+			WOFF += RESULT;
+			WBUSY = WDONE < WLEN && IO->submit(true, FD, WBUF + WDONE, WLEN - WDONE, STREAM ? -1 : WOFF, 'w');
+			if (WDONE < WLEN && !WBUSY) WERR = true;
+		}
+	}
+}
+
+// δȡߵƵ忪ͷ, Ԥಿ
+void AsyncDevice::refill(){
+	if (RBUSY || REND) return;
+	if (RHEAD > 0){
+		memmove(RBUF, RBUF + RHEAD, RTAIL - RHEAD);
+		RTAIL -= RHEAD;
+		RHEAD = 0;
+	}
+	if (RTAIL == AIO_BUFFER) return;
+	RBUSY = IO->submit(false, FD, RBUF + RTAIL, AIO_BUFFER - RTAIL, STREAM ? -1 : ROFF, 'r');
+	if (!RBUSY) REND = true;
+}
+
+// û;дʱFILLȥд
+void AsyncDevice::drain(){
+	if (WBUSY || WERR || FLEN == 0) return;
+	BYTE *T = WBUF;
+	WBUF = FILL;
+	FILL = T;
+	WLEN = FLEN;
+	WDONE = 0;
+	FLEN = 0;
+	WBUSY = IO->submit(true, FD, WBUF, WLEN, STREAM ? -1 : WOFF, 'w');
+	if (!WBUSY) WERR = true;
+}
+
+// ܵ/׽ֵݿһֻһ, ȴSIZE
+size_t AsyncDevice::read(BYTE *DATA, size_t SIZE){
+	if (SIZE > AIO_BUFFER) SIZE = AIO_BUFFER;
+	if (SIZE == 0) return 0;
+	poll(false);
+	if (RTAIL == RHEAD && !REND){
+		refill();
+		poll(false);
+		if (RTAIL == RHEAD && !REND){
+			BLOCKED = 'r';
+			return DEVICE_WAIT;
+		}
+	}
+	if (SIZE > RTAIL - RHEAD) SIZE = RTAIL - RHEAD;
+	memcpy(DATA, RBUF + RHEAD, SIZE);
+	RHEAD += SIZE;
+	// ȡһͿʼһԤ
+	if (RTAIL - RHEAD < AIO_BUFFER / 2) refill();
+	return SIZE;
+}
+
+size_t AsyncDevice::write(const BYTE *DATA, size_t SIZE){
+	if (WERR) return 0;
+	if (SIZE > AIO_BUFFER) SIZE = AIO_BUFFER;
+	poll(false);
+	if (FLEN + SIZE > AIO_BUFFER){
+		drain();
+		if (FLEN + SIZE > AIO_BUFFER){
+			BLOCKED = 'w';
+			return DEVICE_WAIT;
+		}
+	}
+	memcpy(FILL + FLEN, DATA, SIZE);
+	FLEN += SIZE;
+	// ۵һû;дʱͿʼд
+	if (FLEN >= AIO_BUFFER / 2) drain();
+	return SIZE;
+}
+
+// ֱеȫд
+void AsyncDevice::flush(){
+	while (!WERR && (FLEN || WBUSY)){
+		drain();
+		poll(true);
+	}
+}
+
+bool AsyncDevice::ready(){
+	poll(false);
+	if (BLOCKED == 'r') return !RBUSY;
+	if (BLOCKED == 'w') return !WBUSY;
+	return true;
+}
+
+void AsyncDevice::wait(){
+	while (!ready()){
+		poll(true);
+	}
+}
+
+// Ǽһ: ֪ͨڱ߳Ϸ, ֮ͻʱᱻִ߳
+bool AsyncDevice::arm(DEVICE_WAKE WAKE, void *ARG){
+	if (ready()) return false;
+	IO->arm(WAKE, ARG);
+	return true;
+}
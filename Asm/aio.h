@@ -0,0 +1,71 @@
+#ifndef __AIO_H_
+#define __AIO_H_
+
+#include <stdio.h>
+#include "device.h"
+
+// Linuxio_uringύд, ʱ(ں̫ɻ򱻽)˻ص̳߳
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define VM_IO_URING
+#endif
+#endif
+
+#define AIO_DEPTH		8			// ÿ豸ͬʱ;
+#define AIO_THREADS		4			// ̳߳ص߳
+#define AIO_BUFFER		0x10000		// 첽豸Ԥ/дС
+
+// 첽I/O: ύд, ʱTAGȡؽ
+class AsyncIO{
+public:
+	virtual ~AsyncIO(){}
+	// ύOFFSETSIZEֽڵĶ/д, OFFSETΪ-1ʱʹļĵǰλ(ܵ)
+	virtual bool submit(bool WRITE, int FD, BYTE *BUF, size_t SIZE, long long OFFSET, int TAG) = 0;
+	// ȡһɵ, RESULTΪ͵ֽ򸺵Ĵ; ûɵʱWAITǷ
+	virtual bool complete(int &TAG, long long &RESULT, bool WAIT) = 0;
+	// һʱ(δȡʱ)һWAKE(ARG)
+	virtual void arm(DEVICE_WAKE WAKE, void *ARG) = 0;
+	// io_uringʱ̳߳ʵ
+	static AsyncIO *create();
+};
+
+// 첽ļ豸: Ԥ, дȽ첽д, δʱDEVICE_WAIT
+// ÿδAIO_BUFFERֽ; FileDeviceһԷֽ: ݾͷѵĲ,
+// һֽҲûʱŷDEVICE_WAIT, 0ʾļβ
+class AsyncDevice : public Device{
+	AsyncIO *IO;
+	int FD;
+	bool OWN;				// ʱرFD
+	bool STREAM;			// ܵȲܶλļ, ǰλöд
+	// Ԥ: [RHEAD, RTAIL)Ѷδȡߵ, ;ԤдRTAIL֮
+	BYTE *RBUF;
+	size_t RHEAD = 0, RTAIL = 0;
+	long long ROFF = 0;
+	bool RBUSY = false;		// ;Ԥ
+	bool REND = false;		// Ѷļβ
+	// д: OUTдFILL, дflushʱ;WBUF
+	BYTE *FILL, *WBUF;
+	size_t FLEN = 0, WLEN = 0, WDONE = 0;
+	long long WOFF = 0;
+	bool WBUSY = false;		// ;д
+	bool WERR = false;		// д, ֮ݶ
+	char BLOCKED = 0;		// ϴηDEVICE_WAITǶ('r')д('w')
+	void poll(bool WAIT);
+	void refill();
+	void drain();
+public:
+	AsyncDevice(const char *path, const char *mode);
+	AsyncDevice(int fd, bool own = false);
+	~AsyncDevice();
+	bool good() const{
+		return FD >= 0;
+	}
+	size_t read(BYTE *DATA, size_t SIZE);
+	size_t write(const BYTE *DATA, size_t SIZE);
+	void flush();
+	bool ready();
+	void wait();
+	bool arm(DEVICE_WAKE WAKE, void *ARG);
+};
+
+#endif
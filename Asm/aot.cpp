@@ -0,0 +1,280 @@
+#include "aot.h"
+#include <set>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+// ģִܷT(ת); ֵָ֧, ʼ˻ؽ
+static bool translatable(const INST &T, WORD CS, WORD LENGTH){
+	switch (OP_CODE(T.OP)){
+	case LOAD:
+	case ADD:
+	case SUB:
+	case MUL:
+	case DIV:
+	case MOD:
+	case CMP:
+	case NEG:
+	case PUSH:
+	case POP:
+		return true;
+	case STORE:
+		// дεSTORE, Ԥָģ
+		return (T.OP & MR_B) && !(T.IMM + 1 >= CS && T.IMM < LENGTH);
+	default:
+		return false;
+	}
+}
+
+static bool isJump(BYTE OP){
+	return OP == JMP || OP == JB || OP == JG || OP == JE || OP == JNE;
+}
+
+// ѴηC++Դļ, CSתĿ
+// ־JITһֻڻһָ֮; ;˳ʱȲ
+bool CPU::translate(FILE *fp){
+	set<WORD> LEADERS;
+	vector<WORD> WORK(1, CS);
+	INST T;
+	// ҳ
+	while (!WORK.empty()){
+		WORD L = WORK.back();
+		WORK.pop_back();
+		if (L < CS || L >= LENGTH || LEADERS.count(L)) continue;
+		LEADERS.insert(L);
+		int A = L;
+		for (int N = 0; A < LENGTH; N++){
+			decode(A, T);
+			if (A + T.LEN > LENGTH) break;
+			BYTE OP = OP_CODE(T.OP);
+			if (isJump(OP)){
+				WORK.push_back(T.IMM);
+				if (OP != JMP) WORK.push_back(A + T.LEN);
+				break;
+			}
+			// CALL/RETɽִ, ֮ӱ򷵻ص½ģ
+			if (OP == CALL){
+				WORK.push_back(T.IMM);
+				WORK.push_back(A + T.LEN);
+				break;
+			}
+			if (!translatable(T, CS, LENGTH)) break;
+			A += T.LEN;
+			if (N + 1 == AOT_MAX_INST){
+				WORK.push_back(A);
+				break;
+			}
+		}
+	}
+	fprintf(fp, "// AOT module generated by Asm -aot, CS=%04x LENGTH=%04x\n", CS, LENGTH);
+	fprintf(fp, "typedef unsigned char BYTE;\ntypedef unsigned short int WORD;\ntypedef unsigned int UINT;\n");
+	fprintf(fp, "struct ACTX{ WORD *REG; BYTE *RAM; WORD SP; int FUEL; WORD FR; WORD RA, RB, R; };\n");
+	fprintf(fp, "#ifdef _WIN32\n#define AOT_EXPORT extern \"C\" __declspec(dllexport)\n#else\n#define AOT_EXPORT extern \"C\"\n#endif\n");
+	fprintf(fp, "#ifdef __GNUC__\n#pragma GCC diagnostic ignored \"-Wunused-label\"\n#endif\n");
+	fprintf(fp, "static inline WORD flags(WORD FR, WORD RA, WORD RB, WORD R){\n");
+	fprintf(fp, "\tFR &= ~0x%x;\n", BIT_ZERO | BIT_GT | BIT_LT | BIT_NEG);
+	fprintf(fp, "\tif (R == 0) FR |= 0x%x;\n\tif (RA > RB) FR |= 0x%x;\n\tif (RA < RB) FR |= 0x%x;\n", BIT_ZERO, BIT_GT, BIT_LT);
+	fprintf(fp, "\treturn FR;\n}\n");
+	fprintf(fp, "AOT_EXPORT UINT aot_abi(){ return %d; }\n", AOT_ABI);
+	fprintf(fp, "AOT_EXPORT UINT aot_image(WORD *CS, WORD *LENGTH){ *CS = 0x%x; *LENGTH = 0x%x; return 0x%08xu; }\n",
+		CS, LENGTH, checksum(RAM + CS, LENGTH - CS));
+	fprintf(fp, "AOT_EXPORT WORD aot_run(ACTX *ctx, WORD PC){\n");
+	fprintf(fp, "\tWORD *REG = ctx->REG;\n\tBYTE *RAM = ctx->RAM;\n\tWORD SP = ctx->SP;\n\tint FUEL = ctx->FUEL;\n");
+	fprintf(fp, "\tWORD FR = ctx->FR, RA = ctx->RA, RB = ctx->RB, R = ctx->R;\n");
+	fprintf(fp, "\tswitch (PC){\n");
+	for (set<WORD>::iterator it = LEADERS.begin(); it != LEADERS.end(); ++it){
+		fprintf(fp, "\tcase 0x%04x: goto L_%04x;\n", *it, *it);
+	}
+	fprintf(fp, "\tdefault: goto L_EXIT;\n\t}\n");
+	for (set<WORD>::iterator it = LEADERS.begin(); it != LEADERS.end(); ++it){
+		WORD L = *it;
+		// ָһָ
+		vector<WORD> ADDRS;
+		int A = L, FLAGS = -1;
+		while (A < LENGTH && (int)ADDRS.size() < AOT_MAX_INST && (A == L || !LEADERS.count(A))){
+			decode(A, T);
+			if (A + T.LEN > LENGTH || !translatable(T, CS, LENGTH)) break;
+			BYTE OP = OP_CODE(T.OP);
+			if (OP != LOAD && OP != STORE && OP != PUSH && OP != POP) FLAGS = A;
+			ADDRS.push_back(A);
+			A += T.LEN;
+		}
+		if (A < LENGTH && (int)ADDRS.size() < AOT_MAX_INST && (A == L || !LEADERS.count(A))){
+			decode(A, T);
+			if (A + T.LEN <= LENGTH && isJump(OP_CODE(T.OP))) ADDRS.push_back(A);
+		}
+		int N = (int)ADDRS.size();
+		fprintf(fp, "L_%04x:\n", L);
+		if (N == 0){
+			fprintf(fp, "\tPC = 0x%04x; goto L_EXIT;\n", L);
+			continue;
+		}
+		fprintf(fp, "\tif (FUEL < %d){ PC = 0x%04x; goto L_EXIT; }\n\tFUEL -= %d;\n", N, L, N);
+		bool ARITH = false, JUMPED = false;
+		for (int k = 0; k < N; k++){
+			A = ADDRS[k];
+			decode(A, T);
+			BYTE OP = OP_CODE(T.OP);
+			bool B = (T.OP & MR_BYTE) != 0;
+			int REST = N - k;
+			// ָ֮ǰ˳: ˻δִеָ, ϱ־
+			char BAIL[128];
+			snprintf(BAIL, sizeof(BAIL), "{ FUEL += %d;%s PC = 0x%04x; goto L_EXIT; }",
+				REST, ARITH && FLAGS >= A ? " FR = flags(FR, RA, RB, R);" : "", A);
+			fprintf(fp, "\t// %04x %s\n", A, opname(T.OP).c_str());
+			switch (OP){
+			case LOAD:
+				if (T.OP & MR_B){
+					if (B) fprintf(fp, "\tREG[%d] = (REG[%d] & 0xFF00) | RAM[0x%04x];\n", T.RA, T.RA, T.IMM);
+					else fprintf(fp, "\tREG[%d] = RAM[0x%04x] | RAM[0x%04x] << 8;\n", T.RA, T.IMM, (WORD)(T.IMM + 1));
+				}else{
+					if (B) fprintf(fp, "\tREG[%d] = (REG[%d] & 0xFF00) | 0x%02x;\n", T.RA, T.RA, T.IMM & 0xFF);
+					else fprintf(fp, "\tREG[%d] = 0x%04x;\n", T.RA, T.IMM);
+				}
+				break;
+			case STORE:
+				fprintf(fp, "\tRAM[0x%04x] = (BYTE)REG[%d];\n", T.IMM, T.RA);
+				if (!B) fprintf(fp, "\tRAM[0x%04x] = REG[%d] >> 8;\n", (WORD)(T.IMM + 1), T.RA);
+				break;
+			case ADD:
+			case SUB:
+			case MUL:
+			case DIV:
+			case MOD:
+			case CMP:{
+				const char *F = B ? "(BYTE)REG[%d]" : "REG[%d]";
+				char SA[32], SB[32];
+				snprintf(SA, sizeof(SA), F, T.RA);
+				snprintf(SB, sizeof(SB), F, T.RB);
+				if (OP == DIV || OP == MOD) fprintf(fp, "\tif (%s == 0) %s\n", SB, BAIL);
+				fprintf(fp, "\tRA = %s;\n\tRB = %s;\n", SA, SB);
+				switch (OP){
+				case ADD:fprintf(fp, "\tR = RA + RB;\n"); break;
+				case SUB:fprintf(fp, "\tR = RA - RB;\n"); break;
+				case MUL:fprintf(fp, "\tR = RA * RB;\n"); break;
+				case DIV:fprintf(fp, "\tR = RA / RB;\n"); break;
+				case MOD:fprintf(fp, "\tR = RA %% RB;\n"); break;
+				case CMP:fprintf(fp, "\tR = RA == RB;\n"); break;
+				}
+				if (B) fprintf(fp, "\tREG[%d] = (REG[%d] & 0xFF00) | (BYTE)R;\n", T.RC, T.RC);
+				else fprintf(fp, "\tREG[%d] = R;\n", T.RC);
+				ARITH = true;
+				break;
+			}
+			case NEG:
+				fprintf(fp, B ? "\tRA = (BYTE)REG[%d];\n" : "\tRA = REG[%d];\n", T.RA);
+				fprintf(fp, "\tR = 0 - RA;\n");
+				if (B) fprintf(fp, "\tREG[%d] = (REG[%d] & 0xFF00) | (BYTE)R;\n", T.RB, T.RB);
+				else fprintf(fp, "\tREG[%d] = R;\n", T.RB);
+				ARITH = true;
+				break;
+			case PUSH:
+				// ѹջܸдʱ
+				fprintf(fp, "\tif (SP >= 0x%04x && SP <= 0x%04x) %s\n", CS, LENGTH, BAIL);
+				if (!B) fprintf(fp, "\tRAM[SP--] = REG[%d] >> 8;\n", T.RA);
+				fprintf(fp, "\tRAM[SP--] = (BYTE)REG[%d];\n", T.RA);
+				break;
+			case POP:
+				if (B){
+					fprintf(fp, "\tREG[%d] = (REG[%d] & 0xFF00) | RAM[SP++];\n", T.RA, T.RA);
+				}else{
+					fprintf(fp, "\tREG[%d] = RAM[SP++];\n\tREG[%d] |= RAM[SP++] << 8;\n", T.RA, T.RA);
+				}
+				break;
+			default:{
+				// ת, Ŀ겻ģʱ˻ؽ
+				char TO[64], FALL[64];
+				if (LEADERS.count(T.IMM)) snprintf(TO, sizeof(TO), "goto L_%04x;", T.IMM);
+				else snprintf(TO, sizeof(TO), "{ PC = 0x%04x; goto L_EXIT; }", T.IMM);
+				WORD NEXT = A + T.LEN;
+				if (LEADERS.count(NEXT)) snprintf(FALL, sizeof(FALL), "goto L_%04x;", NEXT);
+				else snprintf(FALL, sizeof(FALL), "{ PC = 0x%04x; goto L_EXIT; }", NEXT);
+				switch (OP){
+				case JMP:fprintf(fp, "\t%s\n", TO); break;
+				case JB:fprintf(fp, "\tif (FR & 0x%x) %s\n\t%s\n", BIT_LT, TO, FALL); break;
+				case JG:fprintf(fp, "\tif (FR & 0x%x) %s\n\t%s\n", BIT_GT, TO, FALL); break;
+				case JE:fprintf(fp, "\tif (!(FR & 0x%x)) %s\n\t%s\n", BIT_GT | BIT_LT, TO, FALL); break;
+				case JNE:fprintf(fp, "\tif (FR & 0x%x) %s\n\t%s\n", BIT_GT | BIT_LT, TO, FALL); break;
+				}
+				JUMPED = true;
+				break;
+			}
+			}
+			if (A == FLAGS) fprintf(fp, "\tFR = flags(FR, RA, RB, R);\n");
+		}
+		if (!JUMPED){
+			A = ADDRS.back();
+			decode(A, T);
+			A += T.LEN;
+			if (LEADERS.count(A)) fprintf(fp, "\tgoto L_%04x;\n", A);
+			else fprintf(fp, "\tPC = 0x%04x; goto L_EXIT;\n", A);
+		}
+	}
+	fprintf(fp, "L_EXIT:\n");
+	fprintf(fp, "\tctx->SP = SP;\n\tctx->FUEL = FUEL;\n\tctx->FR = FR; ctx->RA = RA; ctx->RB = RB; ctx->R = R;\n");
+	fprintf(fp, "\treturn PC;\n}\n");
+	return !ferror(fp);
+}
+
+// װAOTģ, ģ鷭ʱĴڵĲܾͬ; pathΪʱжģ
+bool CPU::aot(const char *path){
+	if (MODULE){
+#ifdef _WIN32
+		FreeLibrary((HMODULE)MODULE);
+#else
+		dlclose(MODULE);
+#endif
+	}
+	MODULE = nullptr;
+	AOTFN = nullptr;
+	AOTPATH.clear();
+	if (!path) return true;
+#ifdef _WIN32
+	HMODULE M = LoadLibraryA(path);
+#define AOT_SYM(name)	(M ? (void*)GetProcAddress(M, name) : nullptr)
+#else
+	void *M = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+#define AOT_SYM(name)	(M ? dlsym(M, name) : nullptr)
+#endif
+	AOT_ABI_FN ABI = (AOT_ABI_FN)AOT_SYM("aot_abi");
+	AOT_IMAGE_FN IMAGE = (AOT_IMAGE_FN)AOT_SYM("aot_image");
+	AOT_RUN_FN RUN = (AOT_RUN_FN)AOT_SYM("aot_run");
+#undef AOT_SYM
+	MODULE = (void*)M;
+	WORD MCS, MLENGTH;
+	if (!ABI || !IMAGE || !RUN || ABI() != AOT_ABI){
+		printf("bad AOT module %s\n", path);
+	}else if (IMAGE(&MCS, &MLENGTH) != checksum(RAM + CS, LENGTH - CS) || MCS != CS || MLENGTH != LENGTH){
+		printf("AOT module %s does not match the loaded code\n", path);
+	}else{
+		AOTFN = RUN;
+		AOTPATH = path;
+		return true;
+	}
+	aot(nullptr);
+	return false;
+}
+
+// PCAOTģ, ģ˳ʱIP
+WORD CPU::invoke(WORD PC){
+	ACTX ctx;
+	ctx.REG = REG;
+	ctx.RAM = RAM;
+	ctx.SP = SP;
+	UINT FUEL = CYCLE >= LIMIT ? 0 : LIMIT - CYCLE < AOT_FUEL ? LIMIT - CYCLE : AOT_FUEL;
+	ctx.FUEL = FUEL;
+	ctx.FR = ALU.flags();
+	ctx.RA = ALU.RA;
+	ctx.RB = ALU.RB;
+	ctx.R = ALU.R;
+	PC = AOTFN(&ctx, PC);
+	SP = ctx.SP;
+	ALU.RA = ctx.RA;
+	ALU.RB = ctx.RB;
+	ALU.R = ctx.R;
+	ALU.flags(ctx.FR);
+	CYCLE += FUEL - ctx.FUEL;
+	return PC;
+}
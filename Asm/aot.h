@@ -0,0 +1,28 @@
+#ifndef __AOT_H_
+#define __AOT_H_
+
+#include "vm.h"
+
+// AOT: translate()Ѵεÿ鷭һC++, һ, ֮gotoֱ;
+// ɹaot()װ, ִеתʱJIT, ֵָ֧˻ؽִ
+// ÷: Asm -aot data.bin data.cpp; g++ -O2 -shared -fPIC data.cpp -o data.so; Asm -run data.bin data.so
+#define AOT_ABI			1			// ģӿڰ汾, ɵĴһ
+#define AOT_MAX_INST	256			// ÿ෭ָ
+#define AOT_FUEL		0x10000000	// ÿνģִеָ
+
+// ģл, ɵĴͬĶ
+struct ACTX{
+	WORD *REG;
+	BYTE *RAM;
+	WORD SP;
+	int FUEL;		// ʣִеָ
+	WORD FR;		// ־Ĵ
+	WORD RA, RB, R;	// һĲͽ, ˳ʱдALU
+};
+
+// ģ鵼ĺ
+typedef UINT(*AOT_ABI_FN)();
+typedef UINT(*AOT_IMAGE_FN)(WORD *CS, WORD *LENGTH);	// طʱεУ
+typedef WORD(*AOT_RUN_FN)(ACTX *ctx, WORD PC);		// PCִ, ˳ʱIP
+
+#endif
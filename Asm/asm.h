@@ -6,8 +6,8 @@
 #include <ctype.h>
 #include <list>
 
-#include "inter.h"
 #include "vm.h"
+#include "inter.h"
 
 using namespace std;
 
@@ -65,6 +65,7 @@ private:
 	int DS = 0;
 	int CS = 0;
 	int SS = 0;
+	int STACK_SIZE = 0;
 	Token *s;
 	Lexer *lexer;
 	Codes *cs;
@@ -77,9 +78,10 @@ private:
 		match(NUM);
 		return reg;
 	}
+	// &n: ݶƫnĵַ
 	inline WORD match_addr() {
-		match('#');
-		WORD addr = ((Integer*)s)->value;
+		match('&');
+		WORD addr = DS + ((Integer*)s)->value;
 		match(NUM);
 		return addr;
 	}
@@ -95,6 +97,13 @@ private:
 		}
 		return lables[name];
 	}
+	// procs: ȵúʱȵǼ, ʱϺ
+	Proc* add_proc(string name) {
+		if (funcs.find(name) == funcs.end()) {
+			funcs[name] = new Proc(lexer->line, name, nullptr);
+		}
+		return funcs[name];
+	}
 	// parser
 	void match(int kind){
 		if (s->kind != kind){
@@ -102,27 +111,26 @@ private:
 		}
 		s = lexer->scan();
 	}
+	// ڴ沼: ݶδ0ʼ, ν, ջ0xFFFF
 	void data(){
 		match('.');
 		match(DATA);
-		//cs->offset = cs->width;
-		//cs->width += ((Integer*)s)->value;
-		//DS = 0;
+		DS = 0;
+		CS = DS + ((Integer*)s)->value;
 		match(NUM);
 	}
 	void stack(){
 		match('.');
 		match(STACK);
-		//cs->offset = cs->width;
-		//cs->width += ((Integer*)s)->value;
-		//SS = cs->width;
+		SS = 0xFFFF;
+		STACK_SIZE = ((Integer*)s)->value;
 		match(NUM);
 	}
+	// ִдӴοͷʼ, һproc, haltret
 	void code(){
 		match('.');
 		match(CODE);
-		s = lexer->scan();
-		Code *c = new Code(0, CODE);
+		Code *c;
 		while (s->kind == PROC){
 			c = match_proc();
 			if (c){ 
@@ -135,20 +143,22 @@ private:
 		match(PROC);
 		Word *w = match_word();
 		match(':');
-		Code *body = match_codes();
+		Proc *proc = add_proc(w->str);
+		if (proc->getBody()) throw MultipleDeclaredException(lexer->line);
+		proc->setBody(match_codes());
 		match(ENDP);
-		Proc *proc = new Proc(lexer->line, w->str, body);
-		funcs[w->str] = proc;
 		return proc;
 	}
 	Code* match_codes() {
-		Codes *cs, *c;
-		cs = new Codes(lexer->line);
+		Codes *cs = new Codes(lexer->line);
 		while (s->kind != ENDP) {
 			Code *c;
 			switch (s->kind) {
 			case ID:c = match_label(); break;
-			case CALL: c = match_call(); break;
+			case CALLPROC: c = match_call(); break;
+			case RETPROC: c = match_ret(); break;
+			case ENTERPROC: c = match_enter(); break;
+			case LEAVEPROC: c = match_leave(); break;
 			case LOAD:c = match_load(); break;
 			case STORE:c = match_store(); break;
 			case PUSH:c = match_push(); break;
@@ -175,6 +185,7 @@ private:
 			}
 			if (c) { cs->pushCode(c); }
 		}
+		return cs;
 	}
 	Code* match_label() {
 		Word *w = match_word();
@@ -182,20 +193,21 @@ private:
 		return add_label(w->str);
 	}
 	Code* match_call(){
-		match(CALL);
+		match(CALLPROC);
 		Word *w = match_word();
-		if (funcs.find(w->str) != funcs.end()){
-			Proc *func = funcs[w->str];
-			match(ID);
-			return new Call(lexer->line, func);
-		}
-		throw exception("", 1);
-		return nullptr;
+		return new Call(lexer->line, add_proc(w->str));
 	}
+	// load $r &nݶζ, load $r nװ
 	Code* match_load() {
+		match(LOAD);
 		BYTE reg = match_reg();
+		if (s->kind == NUM){
+			WORD value = ((Integer*)s)->value;
+			match(NUM);
+			return new Load(lexer->line, LOAD, reg, value);
+		}
 		WORD addr = match_addr();
-		return new Load(lexer->line, reg, addr);
+		return new Load(lexer->line, LOAD | MR_B, reg, addr);
 	}
 	Code* match_store(){
 		match(STORE);
@@ -211,17 +223,27 @@ private:
 	Code* match_pop() {
 		match(POP);
 		BYTE reg = match_reg();
-		match(NUM);
 		return new Pop(lexer->line, reg);
 	}
 	Code* match_unary(){
-		match('~');
+		match(s->kind);
 		BYTE reg1 = match_reg();
 		BYTE reg2 = match_reg();
 		return new Unary(lexer->line, NEG, reg1, reg2);
 	}
 	Code* match_arith(){
-		BYTE opt = s->kind;
+		BYTE opt;
+		switch (s->kind) {
+		case '+': opt = ADD; break;
+		case '-': opt = SUB; break;
+		case '*': opt = MUL; break;
+		case '/': opt = DIV; break;
+		case '%': opt = MOD; break;
+		case '<':
+		case '>':
+		case '=': opt = CMP; break;
+		default: opt = s->kind; break;
+		}
 		match(s->kind);
 		BYTE reg1 = match_reg();
 		BYTE reg2 = match_reg();
@@ -229,33 +251,63 @@ private:
 		return new Arith(lexer->line, opt, reg1, reg2, reg3);
 	}
 	Code* match_jmp(){
-		match(JMP);
-		Word *w = match_word();
+		BYTE opt = s->kind;
+		match(s->kind);
+		Word *w = (Word*)s;
 		Label *label = (Label*)add_label(w->str);
 		match(ID);
-		return new Jmp(lexer->line, label);
+		return new Jmp(lexer->line, opt, label);
 	}
 	Code* match_halt(){
 		match(HALT);
 		return new Halt(lexer->line);
 	}
+	Code* match_ret(){
+		match(RETPROC);
+		return new Ret(lexer->line);
+	}
+	Code* match_enter(){
+		match(ENTERPROC);
+		WORD size = ((Integer*)s)->value;
+		match(NUM);
+		return new Enter(lexer->line, size);
+	}
+	Code* match_leave(){
+		match(LEAVEPROC);
+		return new Leave(lexer->line);
+	}
 public:
 	Asm(string fp){
 		lexer = new Lexer(fp);
 	}
 	void parse(){
 		cs = new Codes(lexer->line);
+		s = lexer->scan();
 		data();
 		stack();
 		code();
 	}
+	// Ȳ, CALL/JMPдĿľԵַ
+	// ӳʽCPU::readһ: DS CS SS LENGTH, [0, LENGTH)ڴӳ, ݶȫΪ0
 	void write(FILE *fp){
 		BYTE b = 0x00;
+		map<string, Proc*>::iterator iter;
+		for (iter = funcs.begin(); iter != funcs.end(); iter++){
+			if (!iter->second->getBody()) throw UndeclaredException(lexer->line);
+		}
+		WORD at = CS;
+		cs->layout(at);
+		WORD length = at;
+		if ((UINT)length + STACK_SIZE > 0x10000){
+			printf("code and stack exceed 64K\n");
+		}
 		fwrite(&DS, sizeof(WORD), 1, fp);
 		fwrite(&CS, sizeof(WORD), 1, fp);
 		fwrite(&SS, sizeof(WORD), 1, fp);
-		//fwrite(&cs->width, sizeof(WORD), 1, fp);
-		//fwrite(&b, sizeof(BYTE)*CS, 1, fp);
+		fwrite(&length, sizeof(WORD), 1, fp);
+		for (int i = DS; i < CS; i++){
+			fwrite(&b, sizeof(BYTE), 1, fp);
+		}
 		cs->code(fp);
 	}
 };
@@ -0,0 +1,257 @@
+#include "asm64.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <fstream>
+
+using namespace ISA64;
+
+// ָǷͲ, Inst˳:
+// r/f/d/v //˫/Ĵ, b/w/l/q 1/2/4/8ֽ, F/G /˫
+static const struct{
+	const char *NAME;
+	const char *ARGS;
+} OPS[] = {
+	{"lbi", "rb"}, {"lwi", "rw"}, {"ldi", "rl"}, {"lqi", "rq"}, {"lf1i", "fF"}, {"lf2i", "dG"},
+	{"lad", "rq"}, {"lai", "rrq"},
+	{"lb", "rr"}, {"lw", "rr"}, {"ld", "rr"}, {"lq", "rr"}, {"lf1", "fr"}, {"lf2", "dr"},
+	{"sb", "rr"}, {"sw", "rr"}, {"sd", "rr"}, {"sq", "rr"}, {"sf1", "fr"}, {"sf2", "dr"},
+	{"pushb", "r"}, {"pushw", "r"}, {"pushd", "r"}, {"pushq", "r"}, {"pushf1", "f"}, {"pushf2", "d"},
+	{"popb", "r"}, {"popw", "r"}, {"popd", "r"}, {"popq", "r"}, {"popf1", "f"}, {"popf2", "d"},
+	{"mov", "rr"}, {"movf", "ff"}, {"movd", "dd"},
+	{"jmp", "r"}, {"je", "rrr"}, {"jne", "rrr"}, {"slt", "rrr"}, {"int", "b"},
+	{"di", ""}, {"ei", ""}, {"halt", ""}, {"nop", ""},
+	{"and", "rrr"}, {"or", "rrr"}, {"xor", "rrr"}, {"not", "rr"}, {"bt", "rrr"}, {"bs", "rr"},
+	{"sra", "rrr"}, {"srl", "rrr"}, {"sl", "rrr"},
+	{"add", "rrr"}, {"sub", "rrr"}, {"mul", "rrr"}, {"div", "rrrr"},
+	{"cast_if", "rf"}, {"cast_id", "rd"}, {"cast_fi", "fr"}, {"cast_fd", "fd"}, {"cast_di", "dr"}, {"cast_df", "df"},
+	{"fadd", "fff"}, {"fsub", "fff"}, {"fmul", "fff"}, {"fdiv", "fff"}, {"fslt", "fff"},
+	{"dadd", "ddd"}, {"dsub", "ddd"}, {"dmul", "ddd"}, {"ddiv", "ddd"}, {"dslt", "ddd"},
+	{"vld", "vr"}, {"vst", "vr"}, {"vmov", "vv"}, {"vbcf", "vf"}, {"vbcd", "vd"},
+	{"vfadd", "vvv"}, {"vfsub", "vvv"}, {"vfmul", "vvv"}, {"vfma", "vvv"}, {"vflt", "vvv"}, {"vfsum", "fv"},
+	{"vdadd", "vvv"}, {"vdsub", "vvv"}, {"vdmul", "vvv"}, {"vdfma", "vvv"}, {"vdlt", "vvv"}, {"vdsum", "dv"},
+	{"vsel", "vvvv"},
+};
+static_assert(sizeof(OPS) / sizeof(OPS[0]) == VSEL + 1, "OPS must follow enum Inst");
+
+// հ׺Ͷз, ڵַΪһ()
+static vector<string> split(const string &L){
+	vector<string> T;
+	size_t i = 0;
+	while (i < L.size()){
+		if (isspace((unsigned char)L[i]) || L[i] == ','){
+			i++;
+		}else if (L[i] == '"'){
+			size_t j = i + 1;
+			while (j < L.size() && L[j] != '"'){
+				if (L[j] == '\\') j++;
+				j++;
+			}
+			T.push_back(L.substr(i, j + 1 - i));
+			i = j + 1;
+		}else{
+			size_t j = i;
+			while (j < L.size() && !isspace((unsigned char)L[j]) && L[j] != ',') j++;
+			T.push_back(L.substr(i, j - i));
+			i = j;
+		}
+	}
+	return T;
+}
+
+bool Asm64::error(const char *msg, const string &arg){
+	if (LOG) fprintf(LOG, "line %d: %s %s\n", LINE, msg, arg.c_str());
+	return false;
+}
+
+void Asm64::emit(const void *P, size_t N){
+	if (EMIT){
+		CODE.insert(CODE.end(), (const BYTE*)P, (const BYTE*)P + N);
+	}else{
+		CODE.resize(CODE.size() + N);
+	}
+}
+
+// ; һſܻû, ȵ0
+bool Asm64::integer(const string &T, U8 &V){
+	char *END;
+	if (!T.empty() && (isdigit((unsigned char)T[0]) || T[0] == '-' || T[0] == '+')){
+		V = T[0] == '-' ? (U8)strtoll(T.c_str(), &END, 0) : strtoull(T.c_str(), &END, 0);
+		if (*END) return error("bad number", T);
+		return true;
+	}
+	map<string, U8>::iterator it = LABELS.find(T);
+	if (it != LABELS.end()){
+		V = it->second;
+		return true;
+	}
+	V = 0;
+	return EMIT ? error("undefined label", T) : true;
+}
+
+bool Asm64::line(const string &L){
+	string S = L;
+	bool QUOTE = false;
+	for (size_t i = 0; i < S.size(); i++){
+		if (S[i] == '"' && (i == 0 || S[i - 1] != '\\')) QUOTE = !QUOTE;
+		if (S[i] == ';' && !QUOTE){
+			S.resize(i);
+			break;
+		}
+	}
+	vector<string> T = split(S);
+	size_t k = 0;
+	while (k < T.size() && T[k].size() > 1 && T[k].back() == ':'){
+		string NAME = T[k].substr(0, T[k].size() - 1);
+		if (!EMIT){
+			if (LABELS.count(NAME)) return error("label redefined", NAME);
+			LABELS[NAME] = CODE.size();
+		}
+		k++;
+	}
+	if (k == T.size()) return true;
+	string OP = T[k++];
+	for (size_t i = 0; i < OP.size(); i++) OP[i] = tolower((unsigned char)OP[i]);
+	size_t N = T.size() - k;
+	// αָ
+	if (OP[0] == '.'){
+		U8 V;
+		if (OP == ".heap" || OP == ".stack" || OP == ".space"){
+			if (N != 1 || !integer(T[k], V)) return error("expect a number after", OP);
+			if (OP == ".heap") HEAP = V;
+			else if (OP == ".stack") STACK = V;
+			else if (V > VM64_LIMIT) return error("space too large", T[k]);
+			else if (EMIT) CODE.insert(CODE.end(), (size_t)V, 0);
+			else CODE.resize(CODE.size() + (size_t)V);
+			return true;
+		}
+		if (OP == ".entry"){
+			if (N != 1) return error("expect a label after", OP);
+			ENTRY = T[k];
+			return true;
+		}
+		int W = OP == ".byte" ? 1 : OP == ".word" ? 2 : OP == ".dword" ? 4 : OP == ".quad" ? 8 : 0;
+		if (W){
+			for (; k < T.size(); k++){
+				if (!integer(T[k], V)) return false;
+				BYTE B[8];
+				for (int i = 0; i < W; i++) B[i] = (BYTE)(V >> (i * 8));
+				emit(B, W);
+			}
+			return true;
+		}
+		if (OP == ".float" || OP == ".double"){
+			for (; k < T.size(); k++){
+				char *END;
+				F8 D = strtod(T[k].c_str(), &END);
+				if (*END) return error("bad number", T[k]);
+				F4 F = (F4)D;
+				if (OP == ".float") emit(&F, sizeof(F));
+				else emit(&D, sizeof(D));
+			}
+			return true;
+		}
+		if (OP == ".ascii"){
+			if (N != 1 || T[k].size() < 2 || T[k][0] != '"' || T[k].back() != '"') return error("expect a string after", OP);
+			for (size_t i = 1; i + 1 < T[k].size(); i++){
+				char C = T[k][i];
+				if (C == '\\' && i + 2 < T[k].size()){
+					C = T[k][++i];
+					C = C == 'n' ? '\n' : C == 't' ? '\t' : C == '0' ? '\0' : C == 'r' ? '\r' : C;
+				}
+				emit(&C, 1);
+			}
+			return true;
+		}
+		return error("unknown directive", OP);
+	}
+	// ָ: ֽ֮ARGS˳Ų
+	int I = 0;
+	while (I <= VSEL && OP != OPS[I].NAME) I++;
+	if (I > VSEL) return error("unknown instruction", OP);
+	const char *A = OPS[I].ARGS;
+	if (N != strlen(A)) return error("wrong number of operands for", OP);
+	BYTE B = (BYTE)I;
+	emit(&B, 1);
+	for (; *A; A++, k++){
+		const string &X = T[k];
+		if (*A == 'r' || *A == 'f' || *A == 'd' || *A == 'v'){
+			// $nĴ, $fn/$dnǸĴ, $vnĴ
+			size_t P = 1;
+			if (X.size() < 2 || X[0] != '$') return error("expect a register", X);
+			if (*A != 'r'){
+				if (tolower((unsigned char)X[1]) != *A) return error("wrong register type", X);
+				P = 2;
+			}
+			char *END;
+			long R = strtol(X.c_str() + P, &END, 10);
+			if (P >= X.size() || *END || R < 0 || R > 0xFF) return error("bad register", X);
+			B = (BYTE)R;
+			emit(&B, 1);
+		}else if (*A == 'F' || *A == 'G'){
+			char *END;
+			F8 D = strtod(X.c_str(), &END);
+			if (X.empty() || *END) return error("bad number", X);
+			F4 F = (F4)D;
+			if (*A == 'F') emit(&F, sizeof(F));
+			else emit(&D, sizeof(D));
+		}else{
+			U8 V;
+			if (!integer(X, V)) return false;
+			int W = *A == 'b' ? 1 : *A == 'w' ? 2 : *A == 'l' ? 4 : 8;
+			BYTE IMM[8];
+			for (int i = 0; i < W; i++) IMM[i] = (BYTE)(V >> (i * 8));
+			emit(IMM, W);
+		}
+	}
+	return true;
+}
+
+bool Asm64::assemble(const char *path, FILE *log){
+	ifstream in(path);
+	LOG = log;
+	if (!in){
+		if (LOG) fprintf(LOG, "can't open %s\n", path);
+		return false;
+	}
+	LINES.clear();
+	LABELS.clear();
+	ENTRY.clear();
+	HEAP = ASM64_HEAP;
+	STACK = ASM64_STACK;
+	string L;
+	while (getline(in, L)){
+		if (!L.empty() && L.back() == '\r') L.pop_back();
+		LINES.push_back(L);
+	}
+	for (int pass = 0; pass < 2; pass++){
+		EMIT = pass == 1;
+		CODE.clear();
+		for (LINE = 1; LINE <= (int)LINES.size(); LINE++){
+			if (!line(LINES[LINE - 1])) return false;
+		}
+	}
+	if (!ENTRY.empty() && !LABELS.count(ENTRY)){
+		LINE = 0;
+		return error("undefined entry", ENTRY);
+	}
+	return true;
+}
+
+bool Asm64::save(const char *path){
+	IMAGE64_HEAD H;
+	H.MAGIC = IMAGE64_MAGIC;
+	H.VERSION = IMAGE64_VERSION;
+	H.SIZE = CODE.size();
+	H.HEAP = HEAP;
+	H.STACK = STACK;
+	H.ENTRY = ENTRY.empty() ? 0 : LABELS[ENTRY];
+	FILE *fp = fopen(path, "wb");
+	if (!fp) return false;
+	bool OK = fwrite(&H, sizeof(H), 1, fp) == 1 && fwrite(CODE.data(), 1, CODE.size(), fp) == CODE.size();
+	return fclose(fp) == 0 && OK;
+}
+
+bool Asm64::load(CPU64 *cpu){
+	return cpu->load(CODE.data(), CODE.size(), HEAP, STACK, ENTRY.empty() ? 0 : LABELS[ENTRY]);
+}
@@ -0,0 +1,53 @@
+#ifndef __ASM64_H_
+#define __ASM64_H_
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+#include "vm64.h"
+
+using namespace std;
+
+#define ASM64_HEAP		0x10000		// Ĭ϶ѴС
+#define ASM64_STACK		0x10000		// ĬջС
+
+// 64λָĻ, ÿһָαָ, ';'֮ע:
+//   name:                      , ֵΪһָ/ݵĵַ
+//   add $1 $2 $3               Ĵ$n, $fn, ˫$dn, $vn, ĿļĴǰ
+//   lqi $1 -5 / lad $2 name    ʮ/ʮ
+//   lf2i $d0 2.5               
+//   .byte/.word/.dword/.quad   , , Զ
+//   .float/.double 1.5 ...     
+//   .ascii "text\n"            ַ, 0
+//   .space N                   N0ֽ
+//   .heap N / .stack N         /ջС
+//   .entry name                , ĬΪ0
+// һȷŵĵַ, һɴ
+class Asm64{
+	vector<string> LINES;
+	map<string, U8> LABELS;
+	vector<BYTE> CODE;
+	U8 HEAP = ASM64_HEAP;
+	U8 STACK = ASM64_STACK;
+	string ENTRY;
+	bool EMIT = false;			// ڶɴ, һֻ㳤
+	int LINE = 0;
+	FILE *LOG = nullptr;
+	bool line(const string &L);
+	bool error(const char *msg, const string &arg);
+	bool integer(const string &T, U8 &V);
+	void emit(const void *P, size_t N);
+public:
+	// Դļ, ʱкźԭдlogfalse
+	bool assemble(const char *path, FILE *log = stdout);
+	// ΪIMAGE64ʽӳ
+	bool save(const char *path);
+	// ֱװCPU64
+	bool load(CPU64 *cpu);
+	const vector<BYTE> &code() const{
+		return CODE;
+	}
+};
+
+#endif
@@ -0,0 +1,140 @@
+#include "batch.h"
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string.h>
+
+Batch::~Batch(){
+	for (size_t i = 0; i < QUEUES.size(); i++){
+		delete QUEUES[i];
+	}
+}
+
+void Batch::add(string image, string input){
+	JOB J;
+	J.IMAGE = image;
+	J.INPUT = input;
+	J.EXIT = EXIT_NONE;
+	J.CYCLE = 0;
+	J.IP = 0;
+	J.TIME = 0;
+	J.WORKER = -1;
+	JOBS.push_back(J);
+}
+
+// 嵥, ļ򲻿ʱfalse
+bool Batch::manifest(const char *path){
+	ifstream fin(path);
+	string line;
+	if (!fin){
+		printf("can't open manifest %s\n", path);
+		return false;
+	}
+	while (getline(fin, line)){
+		stringstream ss(line);
+		string image, input;
+		if (!(ss >> image) || image[0] == '#') continue;
+		ss >> input;
+		add(image, input);
+	}
+	return true;
+}
+
+// ȡһ: ȡԼβ, ûʱ̵߳Ķȡ
+bool Batch::take(int ID, size_t &TASK){
+	int N = QUEUES.size();
+	for (int k = 0; k < N; k++){
+		WORKQ *Q = QUEUES[(ID + k) % N];
+		lock_guard<mutex> guard(Q->LOCK);
+		if (Q->TASKS.empty()) continue;
+		if (k == 0){
+			TASK = Q->TASKS.back();
+			Q->TASKS.pop_back();
+		}else{
+			TASK = Q->TASKS.front();
+			Q->TASKS.pop_front();
+		}
+		return true;
+	}
+	return false;
+}
+
+void Batch::worker(int ID){
+	size_t TASK;
+	while (take(ID, TASK)){
+		JOBS[TASK].WORKER = ID;
+		execute(JOBS[TASK]);
+	}
+}
+
+// ļݶ[DS, CS), дԤĴջ; ݶεĲֶ
+// 򲻿ʱfalse, óִ
+bool Batch::input(CPU *cpu, const string &path){
+	FILE *in = fopen(path.c_str(), "rb");
+	if (!in){
+		printf("can't open input %s\n", path.c_str());
+		return false;
+	}
+	size_t SIZE = cpu->CS > cpu->DS ? cpu->CS - cpu->DS : 0;
+	size_t N = fread(&cpu->RAM[cpu->DS], 1, SIZE, in);
+	bool OK = !ferror(in);
+	if (OK && N == SIZE && fgetc(in) != EOF){
+		printf("input %s truncated to the %u-byte data segment\n", path.c_str(), (UINT)SIZE);
+	}
+	fclose(in);
+	if (!OK) printf("can't read input %s\n", path.c_str());
+	return OK;
+}
+
+// µCPUװ벢ִһ, ִBUDGET
+void Batch::execute(JOB &J){
+	chrono::steady_clock::time_point T0 = chrono::steady_clock::now();
+	CPU *cpu = new CPU();
+	cpu->init();
+	if (NATIVE) cpu->jit(true);
+	if (cpu->open(J.IMAGE.c_str()) && (J.INPUT.empty() || input(cpu, J.INPUT))){
+		cpu->execute(BUDGET);
+	}
+	J.EXIT = cpu->EXIT;
+	J.CYCLE = cpu->CYCLE;
+	J.IP = cpu->IP;
+	delete cpu;
+	J.TIME = chrono::duration<double, milli>(chrono::steady_clock::now() - T0).count();
+}
+
+// THREADSִ߳ȫ(0ʾCPU), ǽʱ()
+double Batch::run(int THREADS){
+	vector<thread> POOL;
+	if (THREADS <= 0) THREADS = thread::hardware_concurrency();
+	if (THREADS <= 0) THREADS = 1;
+	for (size_t i = 0; i < QUEUES.size(); i++){
+		delete QUEUES[i];
+	}
+	QUEUES.clear();
+	for (int i = 0; i < THREADS; i++){
+		QUEUES.push_back(new WORKQ());
+	}
+	// ָ߳, ߳ȥȡ
+	for (size_t i = 0; i < JOBS.size(); i++){
+		QUEUES[i % THREADS]->TASKS.push_front(i);
+	}
+	chrono::steady_clock::time_point T0 = chrono::steady_clock::now();
+	for (int i = 0; i < THREADS; i++){
+		POOL.push_back(thread(&Batch::worker, this, i));
+	}
+	for (int i = 0; i < THREADS; i++){
+		POOL[i].join();
+	}
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - T0).count();
+}
+
+void Batch::report(FILE *fp){
+	static const char *EXITS[] = { "error", "halt", "end", "wait", "budget", "fault" };
+	fprintf(fp, "%-24s %-10s %-10s %-6s %-5s %s\n", "image", "cycles", "ms", "exit", "ip", "worker");
+	for (size_t i = 0; i < JOBS.size(); i++){
+		JOB &J = JOBS[i];
+		fprintf(fp, "%-24s %-10u %-10.3f %-6s %04x  %d\n",
+			J.IMAGE.c_str(), J.CYCLE, J.TIME, EXITS[J.EXIT], J.IP, J.WORKER);
+	}
+}
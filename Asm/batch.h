@@ -0,0 +1,59 @@
+#ifndef __BATCH_H_
+#define __BATCH_H_
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include "vm.h"
+
+using namespace std;
+
+#define BATCH_BUDGET	100000000	// Ĭÿִе, ѭĳ򵽴EXIT_BUDGET
+
+// ִеһ
+struct JOB{
+	string IMAGE;		// ӳļ
+	string INPUT;		// ļ, װ󸲸ݶ[DS, CS), Ϊ
+	// ִн
+	BYTE EXIT;			// EXIT_HALT/EXIT_END, ԤʱΪEXIT_BUDGET, װӳʧʱΪEXIT_NONE
+	UINT CYCLE;			// ִ
+	WORD IP;			// ʱIP
+	double TIME;		// ǽʱ()
+	int WORKER;			// ִиó߳
+};
+
+// ̵߳: ԼӶβȡ, ̴߳Ӷȡ
+struct WORKQ{
+	mutex LOCK;
+	deque<size_t> TASKS;
+};
+
+// ִ: 嵥Ѹָȡ̳߳, ÿһCPU
+// 嵥ÿһ: ӳļ [ļ], #ͷΪע
+class Batch{
+	vector<JOB> JOBS;
+	vector<WORKQ*> QUEUES;
+	bool NATIVE = false;		// ÿCPUǷJIT
+	UINT BUDGET = BATCH_BUDGET;	// ÿԤ
+	bool take(int ID, size_t &TASK);
+	void worker(int ID);
+	bool input(CPU *cpu, const string &path);
+	void execute(JOB &J);
+public:
+	~Batch();
+	bool manifest(const char *path);
+	void add(string image, string input);
+	void jit(bool on){
+		NATIVE = on;
+	}
+	// 0ʾ
+	void budget(UINT cycles){
+		BUDGET = cycles ? cycles : BUDGET_ALL;
+	}
+	double run(int THREADS);
+	void report(FILE *fp);
+};
+
+#endif
@@ -6,7 +6,8 @@ typedef unsigned short int WORD;
 typedef unsigned int UINT;
 
 // ʷԪ
-enum Tag{ ID = 256, NUM, REG, RTYPE, ITYPE, JTYPE, END, LABEL, DATA, STACK, CODE, PROC, ENDP, CALL };
+// ַԪ;ַ, 벻С' 'Ĺؼֱֲò, ַ
+enum Tag{ ID = 256, NUM, REG, RTYPE, ITYPE, JTYPE, END, LABEL, DATA, STACK, CODE, PROC, ENDP, CALLPROC, RETPROC, ENTERPROC, LEAVEPROC };
 
 // ָ
 enum Inst{
@@ -19,9 +20,16 @@ enum Inst{
 	MOV, IN, OUT,					// I/O
 	SHL, SHR, SAL, SAR, SRL, SRR,	// Shift
 	LOOP,							// Loop
+	CAS, XADD, FENCE,				// Atomic
+	LOADF, STOREF,					// Far memory
+	MOVS, STOS, CMPS,				// Block
+	CALL, RET, ENTER, LEAVE,		// Procedure
 };
 
 // Ĵ
 enum Reg{ AX, BX, CX, DX, BP, SI, DI, CS, DS, ES, SS, SP };
 
+// CALL/RETķصַջ; صַֻ, ͻ뿴ҲĲ
+#define RSTACK_SIZE	1024
+
 #endif
\ No newline at end of file
@@ -1,8 +1,14 @@
-.data 12
+.data 18
 .stack 1000
 .code
+proc main:
+	enter 0
+	call draw
+	leave
+	halt
+endp
 proc play:
-	sub $sp 0
+	enter 0
 	load $0 &0
 	load $7 1
 	- $0 $7 $8
@@ -15,50 +21,31 @@ proc play:
 	load $11 1
 	- $2 $11 $12
 	store $12 &4;c
+	leave
+	ret
 endp
 proc draw:
-	;x @2
-	;y @4
-	;a1 @0
-	;b1 @2
-	;c1 @4
-	;d1 @6
-	sub $sp 8
-	load $14 @0
-	store $14 @0;a1
-	load $15 @2
-	store $15 @2;b1
-	load $16 @0
-	store $16 @4;c1
-	load $17 @2
-	store $17 @6;d1
-	load $18 @4
-	store $18 @0;e1
-	load $19 @6
-	store $19 @0;f1
-	push $bp
-	load $bp $sp
-	sub $sp 2
+	;a1 &6
+	;b1 &8
+	;c1 &10
+	;d1 &12
+	;e1 &14
+	;f1 &16
+	enter 0
+	load $14 &0
+	store $14 &6;a1
+	load $15 &2
+	store $15 &8;b1
+	load $16 &0
+	store $16 &10;c1
+	load $17 &2
+	store $17 &12;d1
+	load $18 &4
+	store $18 &14;e1
+	load $19 &6
+	store $19 &16;f1
 	call play
-	add $sp 2
-	load $sp $bp
-	pop $bp
-endp
-proc main:
-	;a @0
-	sub $sp 2
-	load $26 10
-	load $27 11
-	push $bp
-	load $bp $sp
-	push $27
-	push $26
-	sub $sp 2
-	call draw
-	add $sp 2
-	pop $26
-	pop $27
-	load $sp $bp
-	pop $bp
+	leave
+	ret
 endp
 #
\ No newline at end of file
@@ -0,0 +1,55 @@
+#include "device.h"
+#include <string.h>
+
+// õFILEѾд, û, Ļ
+FileDevice::FileDevice(FILE *fp, bool own) : fp(fp), OWN(own){
+}
+
+FileDevice::FileDevice(const char *path, const char *mode) : fp(fopen(path, mode)), OWN(true){
+	if (!fp){
+		printf("can't open device %s\n", path);
+		return;
+	}
+	BUFFER = new char[DEVICE_BUFFER];
+	setvbuf(fp, BUFFER, _IOFBF, DEVICE_BUFFER);
+}
+
+FileDevice::~FileDevice(){
+	if (fp){
+		if (OWN){
+			fclose(fp);
+		}else{
+			fflush(fp);
+		}
+	}
+	delete[] BUFFER;
+}
+
+size_t FileDevice::read(BYTE *DATA, size_t SIZE){
+	return fp ? fread(DATA, 1, SIZE, fp) : 0;
+}
+
+size_t FileDevice::write(const BYTE *DATA, size_t SIZE){
+	return fp ? fwrite(DATA, 1, SIZE, fp) : 0;
+}
+
+void FileDevice::flush(){
+	if (fp) fflush(fp);
+}
+
+size_t QueueDevice::read(BYTE *DATA, size_t SIZE){
+	if (SIZE > size()) SIZE = size();
+	memcpy(DATA, this->DATA.data() + HEAD, SIZE);
+	HEAD += SIZE;
+	// պصͷ, 
+	if (HEAD == this->DATA.size()){
+		this->DATA.clear();
+		HEAD = 0;
+	}
+	return SIZE;
+}
+
+size_t QueueDevice::write(const BYTE *DATA, size_t SIZE){
+	this->DATA.insert(this->DATA.end(), DATA, DATA + SIZE);
+	return SIZE;
+}
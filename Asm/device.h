@@ -0,0 +1,74 @@
+#ifndef __DEVICE_H_
+#define __DEVICE_H_
+
+#include <stdio.h>
+#include <vector>
+#include "code.h"
+
+using namespace std;
+
+// ·򿪵ļ豸ʹõĻС
+#define DEVICE_BUFFER	0x10000
+// read/writeķֵ: δ, ѽ, Ժ
+#define DEVICE_WAIT		((size_t)-1)
+
+// 豸֪ͨ, I/O߳ϵ, һǿͻڵ߳
+typedef void (*DEVICE_WAKE)(void *ARG);
+
+// ˿豸: IN/OUTָͨ
+// 豸Դ, /ֽڴͲÿζϵͳ; 鴫(IN &/OUT &)һν豸
+class Device{
+public:
+	virtual ~Device(){}
+	// SIZEֽ, ʵʶֽ, 0ʾûи
+	virtual size_t read(BYTE *DATA, size_t SIZE) = 0;
+	// дSIZEֽ, ʵдֽ
+	virtual size_t write(const BYTE *DATA, size_t SIZE) = 0;
+	virtual void flush(){}
+	// ϴηDEVICE_WAITĴڿԼ
+	virtual bool ready(){
+		return true;
+	}
+	// ֱready()
+	virtual void wait(){}
+	// ʱһWAKE(ARG), ߲ѯready(); ѾʱǼ, false
+	// ֪ͨǰ(ǰ), յԴͼ
+	virtual bool arm(DEVICE_WAKE /*WAKE*/, void * /*ARG*/){
+		return false;
+	}
+};
+
+// ļ/ܵ豸, ͨFILEд
+class FileDevice : public Device{
+	FILE *fp;
+	bool OWN;				// ʱرfp
+	char *BUFFER = nullptr;	// ·ʱʹõĻ
+public:
+	FileDevice(FILE *fp, bool own = false);
+	FileDevice(const char *path, const char *mode);
+	~FileDevice();
+	bool good() const{
+		return fp != nullptr;
+	}
+	size_t read(BYTE *DATA, size_t SIZE);
+	size_t write(const BYTE *DATA, size_t SIZE);
+	void flush();
+};
+
+// ڴ豸: OUTдβ, INӶ׶, ֮CPU֮䴫
+class QueueDevice : public Device{
+	vector<BYTE> DATA;
+	size_t HEAD = 0;		// һֽ
+public:
+	size_t read(BYTE *DATA, size_t SIZE);
+	size_t write(const BYTE *DATA, size_t SIZE);
+	// δ
+	size_t size() const{
+		return DATA.size() - HEAD;
+	}
+	const BYTE *data() const{
+		return DATA.data() + HEAD;
+	}
+};
+
+#endif
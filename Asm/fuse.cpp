@@ -0,0 +1,171 @@
+#include "vm.h"
+#include <sstream>
+#include <algorithm>
+
+// ָ, 
+static const struct{
+	const char *name;
+	UINT mask;
+} FUSIONS[] = {
+	{ "llas", FUSE_LLAS },
+	{ "lla", FUSE_LLA },
+	{ "ls", FUSE_LS },
+	{ "aj", FUSE_AJ },
+};
+
+// ָ, ܳ, ں
+static bool isArithW(const INST &I){
+	BYTE OP = OP_CODE(I.OP);
+	return !(I.OP & MR_BYTE) && OP >= ADD && OP <= CMP && OP != DIV && OP != MOD;
+}
+
+// תָ
+static bool isJcc(const INST &I){
+	BYTE OP = OP_CODE(I.OP);
+	return OP == JB || OP == JG || OP == JE || OP == JNE;
+}
+
+// ԰ADDRʼָںΪһָ
+void CPU::fuse(WORD ADDR){
+	INST T[4];
+	int END[4];
+	int A = ADDR, N;
+	if (!FUSE || ADDR < CS) return;
+	for (N = 0; N < 4 && A < LENGTH; N++){
+		decode(A, T[N]);
+		A += T[N].LEN;
+		END[N] = A;
+	}
+	INST &F = ICACHE[ADDR];
+	if ((FUSE & FUSE_LLAS) && N >= 4 && END[3] <= LENGTH &&
+		T[0].OP == (LOAD | MR_B) && T[1].OP == LOAD && isArithW(T[2]) && T[3].OP == (STORE | MR_B) &&
+		T[2].RA == T[0].RA && T[2].RB == T[1].RA && T[3].RA == T[2].RC){
+		F = T[0];
+		F.OP = F_LLAS;
+		F.LEN = END[3] - ADDR;
+		F.RB = T[1].RA;
+		F.RC = T[2].RC;
+		F.AOP = OP_CODE(T[2].OP);
+		F.IMM2 = T[1].IMM;
+		F.IMM3 = T[3].IMM;
+	}else if ((FUSE & FUSE_LLA) && N >= 3 && END[2] <= LENGTH &&
+		T[0].OP == (LOAD | MR_B) && T[1].OP == LOAD && isArithW(T[2]) &&
+		T[2].RA == T[0].RA && T[2].RB == T[1].RA){
+		F = T[0];
+		F.OP = F_LLA;
+		F.LEN = END[2] - ADDR;
+		F.RB = T[1].RA;
+		F.RC = T[2].RC;
+		F.AOP = OP_CODE(T[2].OP);
+		F.IMM2 = T[1].IMM;
+	}else if ((FUSE & FUSE_LS) && N >= 2 && END[1] <= LENGTH &&
+		T[0].OP == (LOAD | MR_B) && T[1].OP == (STORE | MR_B) && T[1].RA == T[0].RA){
+		F = T[0];
+		F.OP = F_LS;
+		F.LEN = END[1] - ADDR;
+		F.IMM2 = T[1].IMM;
+	}else if ((FUSE & FUSE_AJ) && N >= 2 && END[1] <= LENGTH &&
+		isArithW(T[0]) && isJcc(T[1])){
+		F = T[0];
+		F.OP = F_AJ;
+		F.LEN = END[1] - ADDR;
+		F.AOP = OP_CODE(T[0].OP);
+		F.JOP = OP_CODE(T[1].OP);
+		F.IMM = T[1].IMM;
+	}
+}
+
+// õĳָ, װĴ
+void CPU::fusion(UINT MASK){
+	FUSE = MASK;
+	for (int A = 0; A < LENGTH; A++){
+		decode(A);
+	}
+}
+
+// õĳָ, "llas,aj", "all""none"
+void CPU::fusion(string names){
+	UINT MASK = 0;
+	stringstream ss(names);
+	string name;
+	while (getline(ss, name, ',')){
+		if (name == "all"){
+			MASK |= FUSE_ALL;
+			continue;
+		}
+		for (size_t i = 0; i < sizeof(FUSIONS) / sizeof(FUSIONS[0]); i++){
+			if (name == FUSIONS[i].name){
+				MASK |= FUSIONS[i].mask;
+			}
+		}
+	}
+	fusion(MASK);
+}
+
+#ifdef VM_PROFILE
+// ͳƻִе2~4ָ
+void CPU::ngram(const INST *I){
+	SEQ = SEQ << 8 | I->OP;
+	if (SEQLEN < 4) SEQLEN++;
+	for (int n = 2; n <= SEQLEN; n++){
+		UINT BITS = n == 4 ? 0xFFFFFFFF : (1u << (8 * n)) - 1;
+		NGRAM[(unsigned long long)n << 32 | (SEQ & BITS)]++;
+	}
+	BYTE OP = OP_CODE(I->OP);
+	if ((OP >= JMP && OP <= JBE) || I->OP == F_AJ || OP == HALT){
+		SEQLEN = 0;
+	}
+}
+
+// ʡɴָ, Ϊ³ָĺѡ
+// ÷: VM_PROFILE, fusion("none")װ벢ִеͳ, ٵsuggest
+void CPU::suggest(FILE *fp, int top){
+	vector<pair<unsigned long long, unsigned long long> > ranks;
+	map<unsigned long long, UINT>::iterator iter;
+	for (iter = NGRAM.begin(); iter != NGRAM.end(); iter++){
+		int n = iter->first >> 32;
+		ranks.push_back(make_pair((unsigned long long)iter->second * (n - 1), iter->first));
+	}
+	sort(ranks.rbegin(), ranks.rend());
+	fprintf(fp, "saved     count     sequence\n");
+	for (int i = 0; i < top && i < (int)ranks.size(); i++){
+		int n = ranks[i].second >> 32;
+		UINT SEQ = (UINT)ranks[i].second;
+		fprintf(fp, "%-9llu %-9u", ranks[i].first, NGRAM[ranks[i].second]);
+		for (int k = n - 1; k >= 0; k--){
+			fprintf(fp, " %s;", opname(SEQ >> (8 * k)).c_str());
+		}
+		fprintf(fp, "\n");
+	}
+}
+#endif
+
+string opname(BYTE OP){
+	static const char *NAMES[] = {
+		"halt",
+		"add", "sub", "mul", "div", "mod", "cmp",
+		"jmp", "jne", "jg", "je", "jb", "jge", "jbe",
+		"load", "store",
+		"push", "pop",
+		"neg",
+		"mov", "in", "out",
+		"shl", "shr", "sal", "sar", "srl", "srr",
+		"loop",
+		"cas", "xadd", "fence",
+		"loadf", "storef",
+		"movs", "stos", "cmps",
+		"call", "ret", "enter", "leave",
+	};
+	string name;
+	switch (OP){
+	case F_LLAS:return "[llas]";
+	case F_LLA:return "[lla]";
+	case F_LS:return "[ls]";
+	case F_AJ:return "[aj]";
+	}
+	if (OP_CODE(OP) > LEAVE) return "?";
+	name = NAMES[OP_CODE(OP)];
+	if (OP & MR_BYTE) name += ".b";
+	if (OP & MR_B) name += " &";
+	return name;
+}
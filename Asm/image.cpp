@@ -0,0 +1,337 @@
+#include "image.h"
+#include "vm.h"
+#include <string.h>
+#include <stddef.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+UINT checksum(const void *DATA, size_t SIZE, UINT SEED){
+	const BYTE *P = (const BYTE*)DATA;
+	UINT H = SEED;
+	for (size_t i = 0; i < SIZE; i++){
+		H = (H ^ P[i]) * 16777619u;
+	}
+	return H;
+}
+
+BYTE *ram_alloc(){
+#ifdef _WIN32
+	return (BYTE*)VirtualAlloc(NULL, 0x10000, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+	void *RAM = mmap(NULL, 0x10000, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	return RAM == MAP_FAILED ? NULL : (BYTE*)RAM;
+#endif
+}
+
+void ram_free(BYTE *RAM){
+	if (!RAM) return;
+#ifdef _WIN32
+	VirtualFree(RAM, 0, MEM_RELEASE);
+#else
+	munmap(RAM, 0x10000);
+#endif
+}
+
+void ram_clear(BYTE *RAM){
+#ifndef _WIN32
+	if (mmap(RAM, 0x10000, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == RAM) return;
+#endif
+	memset(RAM, 0, 0x10000);
+}
+
+// Win32MapViewOfFileExҪ64Kĵַƫ, ֱӶ
+bool ram_map(BYTE *RAM, FILE *fp, size_t OFFSET, size_t SIZE){
+	if (SIZE == 0) return true;
+#ifndef _WIN32
+	size_t PAGES = (SIZE + IMAGE_PAGE - 1) & ~(size_t)(IMAGE_PAGE - 1);
+	fflush(fp);
+	void *P = mmap(RAM, PAGES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fileno(fp), OFFSET);
+	if (P == RAM) return true;
+#endif
+	return fseek(fp, (long)OFFSET, SEEK_SET) == 0 && fread(RAM, SIZE, 1, fp) == 1;
+}
+
+#ifdef _WIN32
+RAM_SHARE::~RAM_SHARE(){}
+RAM_SHARE *ram_share(const BYTE *RAM){
+	return nullptr;
+}
+bool ram_same(const BYTE *RAM, const RAM_SHARE *S){
+	return false;
+}
+bool ram_attach(BYTE *RAM, const RAM_SHARE *S){
+	return false;
+}
+#else
+RAM_SHARE::~RAM_SHARE(){
+	if (VIEW) munmap(VIEW, 0x10000);
+	if (FD >= 0) close(FD);
+}
+
+RAM_SHARE *ram_share(const BYTE *RAM){
+	RAM_SHARE *S = new RAM_SHARE();
+#ifdef __linux__
+	S->FD = memfd_create("vm-ram", 0);
+#else
+	FILE *fp = tmpfile();
+	if (fp){
+		S->FD = dup(fileno(fp));
+		fclose(fp);
+	}
+#endif
+	if (S->FD >= 0 && pwrite(S->FD, RAM, 0x10000, 0) == 0x10000){
+		void *P = mmap(NULL, 0x10000, PROT_READ, MAP_SHARED, S->FD, 0);
+		if (P != MAP_FAILED){
+			S->VIEW = (BYTE*)P;
+			return S;
+		}
+	}
+	delete S;
+	return nullptr;
+}
+
+// ҳȽ, ȱȽҳĵһԱ㾡緢ֲͬ
+bool ram_same(const BYTE *RAM, const RAM_SHARE *S){
+	for (int P = 0; P < 0x10000; P += IMAGE_PAGE){
+		if (memcmp(RAM + P, S->VIEW + P, IMAGE_PAGE)) return false;
+	}
+	return true;
+}
+
+bool ram_attach(BYTE *RAM, const RAM_SHARE *S){
+	return mmap(RAM, 0x10000, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, S->FD, 0) == RAM;
+}
+#endif
+
+// װӳ: ֽڸʽֱӳ, ɸʽ(DS CS SS LENGTH + ڴӳ)˻صread
+bool CPU::open(const char *path){
+	IMAGE_HEAD H;
+	IMAGE_SECTION SEC[IMAGE_MAX_SEC];
+	FILE *fp = fopen(path, "rb");
+	if (!fp){
+		printf("can't open image %s\n", path);
+		return false;
+	}
+	if (fread(&H, sizeof(H), 1, fp) != 1 || H.MAGIC != IMAGE_MAGIC){
+		rewind(fp);
+		bool OK = read(fp);
+		fclose(fp);
+		return OK;
+	}
+	bool OK = H.VERSION == IMAGE_VERSION && H.COUNT <= IMAGE_MAX_SEC &&
+		fread(SEC, sizeof(IMAGE_SECTION), H.COUNT, fp) == H.COUNT &&
+		checksum(SEC, sizeof(IMAGE_SECTION) * H.COUNT) == H.CHECKSUM &&
+		(UINT)H.LENGTH + H.STACK <= (UINT)H.SS + 1 &&
+		ram_map(RAM, fp, IMAGE_BASE, H.LENGTH);
+	fclose(fp);
+	DS = CS = H.ENTRY;
+	for (int i = 0; OK && i < H.COUNT; i++){
+		OK = (UINT)SEC[i].ADDR + SEC[i].SIZE <= H.LENGTH &&
+			checksum(RAM + SEC[i].ADDR, SEC[i].SIZE) == SEC[i].CHECKSUM;
+		if (SEC[i].TYPE == SEC_DATA) DS = SEC[i].ADDR;
+		if (SEC[i].TYPE == SEC_CODE) CS = SEC[i].ADDR;
+	}
+	if (!OK){
+		printf("bad image %s\n", path);
+		return false;
+	}
+	SS = SP = H.SS;
+	LENGTH = H.LENGTH;
+	prepare();
+	IP = H.ENTRY;
+	verify();
+	return true;
+}
+
+// ѵǰڴӳ񱣴Ϊֽڸʽ, ݶ[DS, CS), [CS, LENGTH), ΪCS
+bool CPU::save(const char *path){
+	IMAGE_HEAD H;
+	IMAGE_SECTION SEC[2];
+	BYTE ZERO[IMAGE_BASE] = {};
+	FILE *fp = fopen(path, "wb");
+	if (!fp){
+		printf("can't create image %s\n", path);
+		return false;
+	}
+	memset(SEC, 0, sizeof(SEC));
+	SEC[0].TYPE = SEC_DATA;
+	SEC[0].ADDR = DS;
+	SEC[0].SIZE = CS - DS;
+	SEC[0].CHECKSUM = checksum(RAM + DS, CS - DS);
+	SEC[1].TYPE = SEC_CODE;
+	SEC[1].ADDR = CS;
+	SEC[1].SIZE = LENGTH - CS;
+	SEC[1].CHECKSUM = checksum(RAM + CS, LENGTH - CS);
+	memset(&H, 0, sizeof(H));
+	H.MAGIC = IMAGE_MAGIC;
+	H.VERSION = IMAGE_VERSION;
+	H.COUNT = 2;
+	H.ENTRY = CS;
+	H.SS = SS;
+	H.STACK = SS + 1 - LENGTH;
+	H.LENGTH = LENGTH;
+	H.CHECKSUM = checksum(SEC, sizeof(SEC));
+	size_t HEAD = sizeof(H) + sizeof(SEC);
+	bool OK = fwrite(&H, sizeof(H), 1, fp) == 1 &&
+		fwrite(SEC, sizeof(SEC), 1, fp) == 1 &&
+		fwrite(ZERO, IMAGE_BASE - HEAD, 1, fp) == 1 &&
+		(LENGTH == 0 || fwrite(RAM, LENGTH, 1, fp) == 1);
+	fclose(fp);
+	return OK;
+}
+
+// ȫִ״̬д: Ĵ, μĴ, ˿, ־ͷڴҳ
+bool CPU::snapshot(const char *path){
+	SNAP_HEAD H;
+	BYTE ZERO[IMAGE_BASE] = {};
+	FILE *fp = fopen(path, "wb");
+	if (!fp){
+		printf("can't create snapshot %s\n", path);
+		return false;
+	}
+	memset(&H, 0, sizeof(H));
+	H.MAGIC = SNAP_MAGIC;
+	H.VERSION = SNAP_VERSION;
+	for (int i = 0; i < SNAP_PAGES; i++){
+		if (memcmp(RAM + i * IMAGE_PAGE, ZERO, IMAGE_PAGE)){
+			H.PAGES |= 1 << i;
+		}
+	}
+	memcpy(H.REG, REG, sizeof(REG));
+	H.SP = SP; H.BP = BP; H.SI = SI; H.DI = DI;
+	H.CS = CS; H.DS = DS; H.ES = ES; H.SS = SS;
+	memcpy(H.PORT, PORT, sizeof(PORT));
+	H.IP = IP;
+	H.LENGTH = LENGTH;
+	H.FR = ALU.flags();
+	H.RA = ALU.RA; H.RB = ALU.RB; H.R = ALU.R;
+	H.RSP = RSP;
+	memcpy(H.RSTACK, RSTACK, sizeof(RSTACK));
+	H.HALF = HALF;
+	H.FUSE = FUSE;
+	H.NATIVE = NATIVE != nullptr;
+	vector<UINT> FAR;
+	if (PAGING){
+		FAR = PAGING->numbers();
+		H.FARLIMIT = PAGING->limit();
+		H.FARPAGES = (UINT)FAR.size();
+	}
+	H.CYCLE = CYCLE;
+	H.CHECKSUM = checksum(&H, offsetof(SNAP_HEAD, CHECKSUM));
+	bool OK = fwrite(&H, sizeof(H), 1, fp) == 1 &&
+		fwrite(ZERO, IMAGE_BASE - sizeof(H), 1, fp) == 1;
+	for (int i = 0; OK && i < SNAP_PAGES; i++){
+		if (H.PAGES & (1 << i)){
+			OK = fwrite(RAM + i * IMAGE_PAGE, IMAGE_PAGE, 1, fp) == 1;
+		}
+	}
+	for (size_t i = 0; OK && i < FAR.size(); i++){
+		OK = fwrite(&FAR[i], sizeof(UINT), 1, fp) == 1 &&
+			fwrite(PAGING->page(FAR[i], false), FAR_PAGE, 1, fp) == 1;
+	}
+	OK = fclose(fp) == 0 && OK;
+	if (!OK) printf("write snapshot %s failed\n", path);
+	return OK;
+}
+
+// ӿջָ, ڴҳдʱƷʽӳ, ֮executeӿʱIP
+bool CPU::restore(const char *path){
+	SNAP_HEAD H;
+	FILE *fp = fopen(path, "rb");
+	if (!fp){
+		printf("can't open snapshot %s\n", path);
+		return false;
+	}
+	bool OK = fread(&H, sizeof(H), 1, fp) == 1 && H.MAGIC == SNAP_MAGIC &&
+		H.VERSION == SNAP_VERSION && checksum(&H, offsetof(SNAP_HEAD, CHECKSUM)) == H.CHECKSUM &&
+		H.RSP <= RSTACK_SIZE && H.FARPAGES <= H.FARLIMIT;
+	if (OK){
+		ram_clear(RAM);
+		size_t OFFSET = IMAGE_BASE;
+		for (int i = 0; OK && i < SNAP_PAGES; i++){
+			if (H.PAGES & (1 << i)){
+				OK = ram_map(RAM + i * IMAGE_PAGE, fp, OFFSET, IMAGE_PAGE);
+				OFFSET += IMAGE_PAGE;
+			}
+		}
+		PAGING.reset();
+		if (OK && H.FARLIMIT){
+			PAGING.reset(new Paging(H.FARLIMIT));
+			OK = fseek(fp, (long)OFFSET, SEEK_SET) == 0;
+		}
+		for (UINT i = 0; OK && i < H.FARPAGES; i++){
+			UINT N;
+			BYTE *P;
+			OK = fread(&N, sizeof(N), 1, fp) == 1 && N >= FAR_PN(1, 0) &&
+				(P = PAGING->page(N, true)) != nullptr && fread(P, FAR_PAGE, 1, fp) == 1;
+		}
+		flush();
+	}
+	fclose(fp);
+	if (!OK){
+		printf("bad snapshot %s\n", path);
+		return false;
+	}
+	memcpy(REG, H.REG, sizeof(REG));
+	SP = H.SP; BP = H.BP; SI = H.SI; DI = H.DI;
+	CS = H.CS; DS = H.DS; ES = H.ES; SS = H.SS;
+	memcpy(PORT, H.PORT, sizeof(PORT));
+	LENGTH = H.LENGTH;
+	HALF = H.HALF;
+	FUSE = H.FUSE;
+	jit(H.NATIVE != 0);
+	AOTFN = nullptr;
+	prepare();
+	IP = H.IP;
+	ALU.RA = H.RA; ALU.RB = H.RB; ALU.R = H.R;
+	ALU.flags(H.FR);
+	RSP = H.RSP;
+	memcpy(RSTACK, H.RSTACK, sizeof(RSTACK));
+	CYCLE = H.CYCLE;
+	verify();
+	return true;
+}
+
+// 뵱ǰʵ״̬ͬʵ, дʱƷʽڴҳ, ˿ϵ豸Ҳɸӹ
+// forkڼڴδĶʱͬһݶڴ, ֧ӳʱڴ; Զڴҳҳ
+CPU *CPU::fork(){
+	CPU *C = new CPU();
+	if (!C->RAM){
+		delete C;
+		return nullptr;
+	}
+	if (!SHARE || !ram_same(RAM, SHARE.get())){
+		SHARE.reset(ram_share(RAM));
+		if (SHARE && !ram_attach(RAM, SHARE.get())) SHARE.reset();
+	}
+	if (SHARE && ram_attach(C->RAM, SHARE.get())){
+		C->SHARE = SHARE;
+	}else{
+		memcpy(C->RAM, RAM, 0x10000);
+	}
+	memcpy(C->REG, REG, sizeof(REG));
+	C->SP = SP; C->BP = BP; C->SI = SI; C->DI = DI;
+	C->CS = CS; C->DS = DS; C->ES = ES; C->SS = SS;
+	memcpy(C->PORT, PORT, sizeof(PORT));
+	memcpy(C->DEVICE, DEVICE, sizeof(DEVICE));
+	C->HALF = HALF;
+	if (PAGING) C->PAGING.reset(new Paging(*PAGING));
+	C->LENGTH = LENGTH;
+	C->FUSE = FUSE;
+	if (NATIVE) C->jit(true);
+	C->prepare();
+	C->IP = IP;
+	C->RSP = RSP;
+	memcpy(C->RSTACK, RSTACK, RSP * sizeof(WORD));
+	C->VERIFIED = VERIFIED;
+	C->GUARD = GUARD;
+	if (AOTFN) C->aot(AOTPATH.c_str());
+	C->EXIT = EXIT;
+	C->ALU = ALU;
+	C->CYCLE = CYCLE;
+	return C;
+}
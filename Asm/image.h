@@ -0,0 +1,95 @@
+#ifndef __IMAGE_H_
+#define __IMAGE_H_
+
+#include <stdio.h>
+#include "code.h"
+
+// ֽڵĳӳʽ:
+// [IMAGE_HEAD][IMAGE_SECTION * COUNT][0IMAGE_BASE][ڴӳRAM[0, LENGTH)]
+// ڴӳҳ, װʱֱдʱƷʽӳ䵽RAM, ʵδ޸ĵҳ
+#define IMAGE_MAGIC		0x4D494D56	// "VMIM"
+#define IMAGE_VERSION	1
+#define IMAGE_BASE		0x1000		// ڴӳļеƫ
+#define IMAGE_PAGE		0x1000		// ӳҳС
+#define IMAGE_MAX_SEC	8
+
+// 
+enum SectionType{
+	SEC_DATA = 1,	// ݶ
+	SEC_CODE = 2	// 
+};
+
+struct IMAGE_HEAD{
+	UINT MAGIC;
+	WORD VERSION;
+	WORD COUNT;			// 
+	WORD ENTRY;			// IP
+	WORD SS;			// ջַ
+	WORD STACK;			// ջС
+	WORD LENGTH;		// ڴӳ񳤶
+	UINT CHECKSUM;		// ڱУ
+};
+
+struct IMAGE_SECTION{
+	WORD TYPE;
+	WORD ADDR;			// װַ, Ҳڴӳеƫ
+	WORD SIZE;
+	WORD FLAGS;
+	UINT CHECKSUM;		// ݵУ
+};
+
+// ״̬ոʽ: [SNAP_HEAD][0IMAGE_BASE][ڴҳ...][Զڴҳ...]
+// ֻ溬ֽڵҳ, ҳ˳, ָʱҳӳ; Զڴҳÿҳǰ4ֽڵҳ
+// ָJITһ; AOTģ鲻, ִָ, Ҫʱװ
+#define SNAP_MAGIC		0x53534D56	// "VMSS"
+#define SNAP_VERSION	3
+#define SNAP_PAGES		(0x10000 / IMAGE_PAGE)
+
+struct SNAP_HEAD{
+	UINT MAGIC;
+	WORD VERSION;
+	WORD PAGES;			// Щҳ, iλӦRAM[i*IMAGE_PAGE]ʼҳ
+	WORD REG[0x100];
+	WORD SP, BP, SI, DI;
+	WORD CS, DS, ES, SS;
+	WORD PORT[0x100];
+	WORD IP, LENGTH;
+	WORD FR, RA, RB, R;	// ALU
+	WORD RSP;			// صַջ
+	WORD RSTACK[RSTACK_SIZE];
+	int HALF;			// ֶݴİ
+	UINT FUSE;			// õĳָ
+	UINT NATIVE;		// ǷJIT
+	UINT FARLIMIT;		// Զڴҳ, ûԶڴʱΪ0
+	UINT FARPAGES;		// Զڴҳ
+	UINT CYCLE;
+	UINT CHECKSUM;		// ϸУ
+};
+static_assert(sizeof(SNAP_HEAD) <= IMAGE_BASE, "SNAP_HEAD must fit before IMAGE_BASE");
+
+// FNV-1aУ
+UINT checksum(const void *DATA, size_t SIZE, UINT SEED = 2166136261u);
+
+// 64Kڴ, ҳ벢
+BYTE *ram_alloc();
+void ram_free(BYTE *RAM);
+// RAM, ǰļӳ
+void ram_clear(BYTE *RAM);
+// ļOFFSETʼSIZEֽдʱƷʽӳ䵽RAM, ֧ӳʱ
+bool ram_map(BYTE *RAM, FILE *fp, size_t OFFSET, size_t SIZE);
+
+// ڴ: ĳһʱRAMڴļֻͼ
+// forkʵдʱƷʽӳͬһڴļ, ֻΪдҳƴ
+struct RAM_SHARE{
+	int FD = -1;
+	BYTE *VIEW = nullptr;
+	~RAM_SHARE();
+};
+// RAMдµڴļ, ֧ʱؿ
+RAM_SHARE *ram_share(const BYTE *RAM);
+// RAM붳ʱûиĶ
+bool ram_same(const BYTE *RAM, const RAM_SHARE *S);
+// ѶڴдʱƷʽӳ䵽RAM
+bool ram_attach(BYTE *RAM, const RAM_SHARE *S);
+
+#endif
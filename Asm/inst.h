@@ -1,19 +1,22 @@
 #pragma once
 
-typedef char S1;
+// 64λָ; longWindowsֻ32λ, 8ֽlong long
+typedef signed char S1;
 typedef short int S2;
 typedef int S4;
-typedef long int S8;
+typedef long long S8;
 
 typedef unsigned char U1;
 typedef unsigned short int U2;
 typedef unsigned int U4;
-typedef unsigned long int U8;
+typedef unsigned long long U8;
 
 typedef float F4;
 typedef double F8;
 
-// ָ
+// ָ, vm64.cppִ, asm64.cpp
+// 16λָ(code.h)ָͬ, ֿռISA64
+namespace ISA64{
 enum Inst {
 	LBI, LWI, LDI, LQI, LF1I, LF2I,
 	LAD, LAI,
@@ -28,8 +31,16 @@ enum Inst {
 	ADD, SUB, MUL, DIV,
 	CAST_IF, CAST_ID, CAST_FI, CAST_FD, CAST_DI, CAST_DF,
 	FADD, FSUB, FMUL, FDIV, FSLT,
-	DADD, DSUB, DMUL, DDIV, DSLT
+	DADD, DSUB, DMUL, DDIV, DSLT,
+	VLD, VST, VMOV, VBCF, VBCD,
+	VFADD, VFSUB, VFMUL, VFMA, VFLT, VFSUM,
+	VDADD, VDSUB, VDMUL, VDFMA, VDLT, VDSUM,
+	VSEL
 };
+}
+
+// ԭеָݸ, ûдչ; ִvm64.cppΪ׼(ôԽͳEXIT_FAULTͣ,
+// Сֵ-1õСֵ, תԽõ0x8000000000000000), BT/BS/CAST_*/F*/D*ֻvm64.cppʵ
 
 // Load
 
@@ -48,7 +59,7 @@ enum Inst {
 #define EXEC_LF1I();	RF[RAM[IP+1]]=(F4)*((F4*)&RAM[IP+2]);\
 						IP+=6;
 
-#define EXEC_LF2I();	RF[RAM[IP+1]]=(F8)*((F8*)&RAM[IP+2]);\
+#define EXEC_LF2I();	RD[RAM[IP+1]]=(F8)*((F8*)&RAM[IP+2]);\
 						IP+=10;
 
 #define EXEC_LAD();		R[RAM[IP+1]]=(U8)*((U8*)&RAM[IP+2]);\
@@ -118,7 +129,7 @@ enum Inst {
 						IP+=2;
 
 #define	EXEC_PUSHF2();	SP-=8;\
-						*((F8*)&RAM[SP])=(F8)(RF[RAM[IP+1]]);\
+						*((F8*)&RAM[SP])=(F8)(RD[RAM[IP+1]]);\
 						IP+=2;
 
 // Pop
@@ -181,9 +192,11 @@ enum Inst {
 #define EXEC_INT();		HANDLE_INT((U1)RAM[IP+1]);\
 						IP+=2;
 
-#define EXEC_DI();		INT0=FALSE;
+#define EXEC_DI();		INT0=false;\
+						IP++;
 
-#define EXEC_EI();		INT0=TRUE;
+#define EXEC_EI();		INT0=true;\
+						IP++;
 
 #define EXEC_HALT();	;
 
@@ -233,4 +246,15 @@ enum Inst {
 
 #define EXEC_DIV();		R[RAM[IP+1]]=((S8)R[RAM[IP+3]]) / ((S8)R[RAM[IP+4]]);\
 						R[RAM[IP+2]]=((S8)R[RAM[IP+3]]) % ((S8)R[RAM[IP+4]]);\
-						IP+=5;
\ No newline at end of file
+						IP+=5;
+
+// Vector: ĴRV256λ, 8F44F8, vec64.hʵ
+//   VLD $v $r / VST $v $r        RVڴ[R, R+32)֮䴫, 3ֽ
+//   VMOV $v $v                   3ֽ
+//   VBCF $v $f / VBCD $v $d      RF/RDƵÿһ, 3ֽ
+//   VFADD/VFSUB/VFMUL $v $v $v   , Ŀǰ, 4ֽ
+//   VFMA $v $v $v                RV[a] += RV[b] * RV[c], ֻһ, 4ֽ
+//   VFLT $v $v $v                RV[b] < RV[c]ĵΪȫ1, Ϊ0, 4ֽ
+//   VFSUM $f $v                  ֮, Ϊ(l0+l4 + l2+l6) + (l1+l5 + l3+l7), 3ֽ
+//   VD*                          ͬ, F8, VDSUMΪ(l0+l2) + (l1+l3)
+//   VSEL $v $m $v $v             RV[a] = RV[m] ? RV[c] : RV[d], λѡ, 5ֽ
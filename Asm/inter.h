@@ -6,10 +6,16 @@ class Code {
 protected:
 	BYTE opt;
 	WORD line = 0;// ǰָڻļеλ
-	WORD offset = 0;// ǰεƫ
+	WORD offset = 0;// ǰָľԵַ, layout
 public:
-	int getWitdh() { return 0; }
+	virtual int getWidth() { return 0; }
+	WORD getOffset() { return offset; }
 	Code(int line, BYTE opt) :line(line), opt(opt) { ; }
+	// : atθÿָĵַ, atǰһָ
+	virtual void layout(WORD &at){
+		offset = at;
+		at += getWidth();
+	}
 	virtual void code(FILE* fp){
 		printf("[%04d][%04x]", line, offset);
 	}
@@ -20,14 +26,21 @@ class Codes : public Code{
 public:
 	Codes(int line) : Code(line, CODE) { ; }
 	void pushCode(Code *c) { codes.push_back(c); }
-	int getWidth() {
-		int width;
+	virtual int getWidth() {
+		int width = 0;
 		list<Code*>::iterator iter;
 		for (iter = codes.begin(); iter != codes.end(); iter++) {
-			width += (*iter)->getWitdh();
+			width += (*iter)->getWidth();
 		}
 		return width;
 	}
+	virtual void layout(WORD &at){
+		offset = at;
+		list<Code*>::iterator iter;
+		for (iter = codes.begin(); iter != codes.end(); iter++) {
+			(*iter)->layout(at);
+		}
+	}
 	virtual void code(FILE* fp){
 		list<Code*>::iterator iter;
 		for (iter = codes.begin(); iter != codes.end(); iter++){
@@ -52,6 +65,10 @@ class Label : public Code {
 	string name;
 public:
 	Label(int line, string name) : Code(line, LABEL), name(name) { ; }
+	virtual void code(FILE* fp){
+		Code::code(fp);
+		printf("%s:\n", name.c_str());
+	}
 };
 
 class Proc : public Code {
@@ -59,6 +76,14 @@ class Proc : public Code {
 	Code *body;
 public:
 	Proc(int line, string name, Code *body) :Code(line, PROC), name(name), body(body) { ; }
+	string getName() { return name; }
+	Code* getBody() { return body; }
+	void setBody(Code *body) { this->body = body; }
+	virtual int getWidth() { return body->getWidth(); }
+	virtual void layout(WORD &at){
+		offset = at;
+		body->layout(at);
+	}
 	virtual void code(FILE* fp) {
 		Code::code(fp);
 		body->code(fp);
@@ -69,6 +94,7 @@ class Arith : public Code {
 	BYTE reg1, reg2, reg3;
 public:
 	Arith(int line, BYTE opt, BYTE reg1, WORD reg2, WORD reg3) : Code(line, opt), reg1(reg1), reg2(reg2), reg3(reg3) { ; }
+	virtual int getWidth() { return 4; }
 	virtual void code(FILE* fp) {
 		Code::code(fp);
 		printf("bino\t$%02x $%02x $%02x $%02x\n", opt, reg1, reg2, reg3);
@@ -83,6 +109,7 @@ class Unary : public Code {
 	BYTE reg1, reg2;
 public:
 	Unary(int line, BYTE opt, BYTE reg1, BYTE reg2) :Code(line, opt), reg1(reg1), reg2(reg2) { ; }
+	virtual int getWidth() { return 3; }
 	virtual void code(FILE* fp) {
 		Code::code(fp);
 		printf("unary\t$%02x $%02x $%02x\n", opt, reg1, reg2);
@@ -96,7 +123,9 @@ class Load : public Code{
 	BYTE reg;
 	WORD addr;
 public:
-	Load(int line, BYTE reg, WORD addr) : Code(line, LOAD), reg(reg), addr(addr) { }
+	// optΪLOADʱaddr, ΪLOAD | MR_Bʱǵַ
+	Load(int line, BYTE opt, BYTE reg, WORD addr) : Code(line, opt), reg(reg), addr(addr) { }
+	virtual int getWidth() { return 4; }
 	virtual void code(FILE* fp){
 		Code::code(fp);
 		printf("load\t$%02x $%02x $%04x\n", opt, reg, addr);
@@ -110,10 +139,11 @@ class Store : public Code {
 	BYTE reg;
 	WORD addr;
 public:
-	Store(int line, BYTE reg, WORD addr) : Code(line, STORE), reg(reg), addr(addr) { }
+	Store(int line, BYTE reg, WORD addr) : Code(line, STORE | MR_B), reg(reg), addr(addr) { }
+	virtual int getWidth() { return 4; }
 	virtual void code(FILE* fp){
 		Code::code(fp);
-		printf("store\t$%02x $%02x $%04x\n", STORE, reg, addr);
+		printf("store\t$%02x $%02x $%04x\n", opt, reg, addr);
 		fwrite(&opt, sizeof(BYTE), 1, fp);
 		fwrite(&reg, sizeof(BYTE), 1, fp);
 		fwrite(&addr, sizeof(WORD), 1, fp);
@@ -124,6 +154,7 @@ class Push : public Code{
 	BYTE reg;
 public:
 	Push(int line, BYTE reg) : Code(line, PUSH), reg(reg) { ; }
+	virtual int getWidth() { return 2; }
 	virtual void code(FILE* fp){
 		Code::code(fp);
 		printf("push\t$%02x $%02x\n", opt, reg);
@@ -136,6 +167,7 @@ class Pop : public Code{
 	BYTE reg;
 public:
 	Pop(int line, BYTE reg) : Code(line, POP), reg(reg) { ; }
+	virtual int getWidth() { return 2; }
 	virtual void code(FILE* fp){
 		Code::code(fp);
 		printf("pop\t$%02x $%02x\n", opt, reg);
@@ -147,12 +179,14 @@ public:
 class Jmp : public Code {
 	Label *label;
 public:
-	Jmp(int line, Label *label) : Code(line, JMP), label(label) { ; }
+	Jmp(int line, BYTE opt, Label *label) : Code(line, opt), label(label) { ; }
+	virtual int getWidth() { return 3; }
 	virtual void code(FILE* fp) {
 		Code::code(fp);
-		//printf("jmp \t$%02x $%04x\n", opt, addr->offset);
-		//fwrite(&opt, sizeof(BYTE), 1, fp);
-		//fwrite(&addr->offset, sizeof(WORD), 1, fp);
+		WORD addr = label->getOffset();
+		printf("jmp \t$%02x $%04x\n", opt, addr);
+		fwrite(&opt, sizeof(BYTE), 1, fp);
+		fwrite(&addr, sizeof(WORD), 1, fp);
 	}
 };
 
@@ -168,20 +202,61 @@ class Param : public Code {
 class Call : public Code {
 	Proc *func;// 
 public:
-	Call(int line, Proc *func) : Code(line, PROC), func(func) { ; }
+	Call(int line, Proc *func) : Code(line, CALL), func(func) { ; }
+	virtual int getWidth() { return 3; }
 	virtual void code(FILE* fp) {
 		Code::code(fp);
-		//printf("call\t$%04x;%s\n", func->offset, func->name.c_str());
-		//fwrite(&opt, sizeof(BYTE), 1, fp);
+		WORD addr = func->getOffset();
+		printf("call\t$%02x $%04x;%s\n", opt, addr, func->getName().c_str());
+		fwrite(&opt, sizeof(BYTE), 1, fp);
+		fwrite(&addr, sizeof(WORD), 1, fp);
+	}
+};
+
+class Ret : public Code {
+public:
+	Ret(int line) : Code(line, RET) { ; }
+	virtual int getWidth() { return 1; }
+	virtual void code(FILE* fp){
+		Code::code(fp);
+		printf("ret\t$%02x\n", opt);
+		fwrite(&opt, sizeof(BYTE), 1, fp);
+	}
+};
+
+// enter size: push $bp; $bp = sp; sp -= size
+class Enter : public Code {
+	WORD size;// ֲֽ
+public:
+	Enter(int line, WORD size) : Code(line, ENTER), size(size) { ; }
+	virtual int getWidth() { return 3; }
+	virtual void code(FILE* fp){
+		Code::code(fp);
+		printf("enter\t$%02x $%04x\n", opt, size);
+		fwrite(&opt, sizeof(BYTE), 1, fp);
+		fwrite(&size, sizeof(WORD), 1, fp);
+	}
+};
+
+// leave: sp = $bp; pop $bp
+class Leave : public Code {
+public:
+	Leave(int line) : Code(line, LEAVE) { ; }
+	virtual int getWidth() { return 1; }
+	virtual void code(FILE* fp){
+		Code::code(fp);
+		printf("leave\t$%02x\n", opt);
+		fwrite(&opt, sizeof(BYTE), 1, fp);
 	}
 };
 
 class Halt: public Code {
 public:
 	Halt(int line) : Code(line, HALT) { ; }
+	virtual int getWidth() { return 1; }
 	virtual void code(FILE* fp){
 		Code::code(fp);
-		//printf("halt\t$%02x\n", opt);
-		//fwrite(&opt, sizeof(BYTE), 1, fp);
+		printf("halt\t$%02x\n", opt);
+		fwrite(&opt, sizeof(BYTE), 1, fp);
 	}
 };
\ No newline at end of file
@@ -0,0 +1,320 @@
+#include "jit.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+JIT::JIT(WORD LENGTH){
+#ifdef _WIN32
+	CODE = (BYTE*)VirtualAlloc(NULL, JIT_CODE_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+#else
+	CODE = (BYTE*)mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (CODE == MAP_FAILED) CODE = NULL;
+#endif
+	BLOCKS.assign(LENGTH, nullptr);
+	HEAT.assign(LENGTH, 0);
+	if (CODE){
+		RET = CODE;
+		*RET = 0xC3;// ret
+		USED = 1;
+	}
+}
+
+JIT::~JIT(){
+	flush();
+	if (!CODE) return;
+#ifdef _WIN32
+	VirtualFree(CODE, 0, MEM_RELEASE);
+#else
+	munmap(CODE, JIT_CODE_SIZE);
+#endif
+}
+
+// ȫش
+void JIT::flush(){
+	list<BLOCK*>::iterator iter;
+	for (iter = ALL.begin(); iter != ALL.end(); iter++){
+		delete *iter;
+	}
+	ALL.clear();
+	SLOTS.clear();
+	BLOCKS.assign(BLOCKS.size(), nullptr);
+	HEAT.assign(HEAT.size(), 0);
+	USED = 1;
+}
+
+// һ: eax=TARGET, תTARGETĻ򷵻ؽ
+void JIT::exit(WORD TARGET){
+	B(0xB8); D(TARGET);				// mov eax, TARGET
+	B(0xFF); B(0x25); D(0);			// jmp [rip+0]
+	BYTE **SLOT = (BYTE**)P;
+	BLOCK *BL = lookup(TARGET);
+	BYTE *TO = BL ? BL->CHAIN : RET;
+	memcpy(P, &TO, sizeof(TO));
+	P += sizeof(TO);
+	SLOTS.insert(make_pair(TARGET, SLOT));
+}
+
+// BLʼIPĲָBL
+void JIT::link(BLOCK *BL){
+	multimap<WORD, BYTE**>::iterator iter;
+	for (iter = SLOTS.lower_bound(BL->START); iter != SLOTS.upper_bound(BL->START); iter++){
+		memcpy(iter->second, &BL->CHAIN, sizeof(BL->CHAIN));
+	}
+}
+
+// ϸADDR..ADDR+1Ļ, ǵĲָ򷵻׮
+void JIT::invalidate(WORD ADDR){
+	list<BLOCK*>::iterator iter = ALL.begin();
+	multimap<WORD, BYTE**>::iterator slot;
+	while (iter != ALL.end()){
+		BLOCK *BL = *iter;
+		if (ADDR + 1 >= BL->START && ADDR < BL->END){
+			for (slot = SLOTS.lower_bound(BL->START); slot != SLOTS.upper_bound(BL->START); slot++){
+				memcpy(slot->second, &RET, sizeof(RET));
+			}
+			BLOCKS[BL->START] = nullptr;
+			HEAT[BL->START] = 0;
+			delete BL;
+			iter = ALL.erase(iter);
+		}else{
+			iter++;
+		}
+	}
+}
+
+// شִܷT(ת)
+bool JIT::supported(CPU &cpu, const INST &T){
+	switch (OP_CODE(T.OP)){
+	case LOAD:
+		// ش밴ֱӷRAM, 0xFFFFҪƻ, 
+		return (T.OP & (MR_B | MR_BYTE)) != MR_B || T.IMM != 0xFFFF;
+	case ADD:
+	case SUB:
+	case MUL:
+	case CMP:
+		return true;
+	case STORE:
+		// дεSTORE, Ԥָͻ
+		return (T.OP & MR_B) && !(T.IMM + 1 >= cpu.CS && T.IMM < cpu.LENGTH) && ((T.OP & MR_BYTE) || T.IMM != 0xFFFF);
+	default:
+		return false;
+	}
+}
+
+// IPʼĻ, һָͲ֧ʱnullptr
+// ĴԼ: r8=REG(Ĵnλr8+2n, ֽڲֽ), r9=RAM, r10=JCTX, eax/ecx/edx/r11ΪʱĴ(ֵԼ¶豣)
+BLOCK *JIT::compile(CPU &cpu, WORD IP){
+#ifndef VM_JIT_X64
+	return nullptr;
+#else
+	INST T;
+	int A = IP, N = 0;
+	bool END = false;
+	if (!CODE) return nullptr;
+	// ־ֻڻһָ, ֮ǰĶᱻ
+	int FLAGS = -1;
+	for (N = 0; N < JIT_MAX_INST && A < cpu.LENGTH; N++){
+		cpu.decode(A, T);
+		if (A + T.LEN > cpu.LENGTH || !supported(cpu, T)) break;
+		BYTE OP = OP_CODE(T.OP);
+		if (OP != LOAD && OP != STORE) FLAGS = A;
+		A += T.LEN;
+	}
+	A = IP;
+	N = 0;
+	if (USED + JIT_BLOCK_SIZE > JIT_CODE_SIZE) flush();
+	P = CODE + USED;
+	BYTE *ENTRY = P;
+#ifdef _WIN32
+	B(0x49); B(0x89); B(0xCA);					// mov r10, rcx
+#else
+	B(0x49); B(0x89); B(0xFA);					// mov r10, rdi
+#endif
+	B(0x4D); B(0x8B); B(0x42); B(0x00);			// mov r8, [r10+0]
+	B(0x4D); B(0x8B); B(0x4A); B(0x08);			// mov r9, [r10+8]
+	BYTE *CHAIN = P;
+	B(0x41); B(0x81); B(0x7A); B(0x10);			// cmp dword [r10+16], COUNT
+	BYTE *COUNT1 = P; D(0);
+	B(0x0F); B(0x8C);							// jl FAIL
+	BYTE *FAIL = P; D(0);
+	B(0x41); B(0x81); B(0x6A); B(0x10);			// sub dword [r10+16], COUNT
+	BYTE *COUNT2 = P; D(0);
+	while (!END && N < JIT_MAX_INST && A < cpu.LENGTH){
+		cpu.decode(A, T);
+		if (A + T.LEN > cpu.LENGTH) break;
+		BYTE OP = OP_CODE(T.OP);
+		bool BYTE_OP = (T.OP & MR_BYTE) != 0;
+		bool OK = true;
+		switch (OP){
+		case LOAD:
+			if (!supported(cpu, T)){
+				OK = false;
+				break;
+			}
+			if (T.OP & MR_B){
+				B(0x41); B(0x0F); B(BYTE_OP ? 0xB6 : 0xB7); B(0x81); D(T.IMM);	// movzx eax, [r9+IMM]
+				if (BYTE_OP){
+					B(0x41); B(0x88); B(0x80); D(T.RA * 2);						// mov [r8+RA], al
+				}else{
+					B(0x66); B(0x41); B(0x89); B(0x80); D(T.RA * 2);			// mov [r8+RA], ax
+				}
+			}else if (BYTE_OP){
+				B(0x41); B(0xC6); B(0x80); D(T.RA * 2); B((BYTE)T.IMM);			// mov byte [r8+RA], IMM
+			}else{
+				B(0x66); B(0x41); B(0xC7); B(0x80); D(T.RA * 2); W(T.IMM);		// mov word [r8+RA], IMM
+			}
+			break;
+		case STORE:
+			if (!supported(cpu, T)){
+				OK = false;
+				break;
+			}
+			B(0x41); B(0x0F); B(BYTE_OP ? 0xB6 : 0xB7); B(0x80); D(T.RA * 2);		// movzx eax, [r8+RA]
+			if (BYTE_OP){
+				B(0x41); B(0x88); B(0x81); D(T.IMM);						// mov [r9+IMM], al
+			}else{
+				B(0x66); B(0x41); B(0x89); B(0x81); D(T.IMM);				// mov [r9+IMM], ax
+			}
+			break;
+		case ADD:
+		case SUB:
+		case MUL:
+		case CMP:
+			B(0x41); B(0x0F); B(BYTE_OP ? 0xB6 : 0xB7); B(0x80); D(T.RA * 2);		// movzx eax, [r8+RA]
+			B(0x41); B(0x0F); B(BYTE_OP ? 0xB6 : 0xB7); B(0x88); D(T.RB * 2);		// movzx ecx, [r8+RB]
+			switch (OP){
+			case ADD:B(0x89); B(0xC2); B(0x01); B(0xCA); break;				// mov edx, eax; add edx, ecx
+			case SUB:B(0x89); B(0xC2); B(0x29); B(0xCA); break;				// mov edx, eax; sub edx, ecx
+			case MUL:B(0x89); B(0xC2); B(0x0F); B(0xAF); B(0xD1); break;	// mov edx, eax; imul edx, ecx
+			case CMP:B(0x31); B(0xD2); B(0x39); B(0xC8); B(0x0F); B(0x94); B(0xC2); break;// xor edx, edx; cmp eax, ecx; sete dl
+			}
+			if (BYTE_OP){
+				B(0x41); B(0x88); B(0x90); D(T.RC * 2);						// mov [r8+RC], dl
+			}else{
+				B(0x66); B(0x41); B(0x89); B(0x90); D(T.RC * 2);			// mov [r8+RC], dx
+			}
+			if (A != FLAGS) break;
+			B(0x66); B(0x41); B(0x89); B(0x42); B(22);					// mov [r10+22], ax
+			B(0x66); B(0x41); B(0x89); B(0x4A); B(24);					// mov [r10+24], cx
+			B(0x66); B(0x41); B(0x89); B(0x52); B(26);					// mov [r10+26], dx
+			// ALU::flagsͬı־: ZERO16λ, GT/LT޷Ų
+			B(0x45); B(0x31); B(0xDB);									// xor r11d, r11d
+			B(0x66); B(0x85); B(0xD2);									// test dx, dx
+			B(0x41); B(0x0F); B(0x94); B(0xC3);							// setz r11b
+			B(0x41); B(0xC1); B(0xE3); B(12);							// shl r11d, 12
+			B(0x31); B(0xD2); B(0x39); B(0xC8); B(0x0F); B(0x97); B(0xC2);// xor edx, edx; cmp eax, ecx; seta dl
+			B(0xC1); B(0xE2); B(10);									// shl edx, 10
+			B(0x41); B(0x09); B(0xD3);									// or r11d, edx
+			B(0x31); B(0xD2); B(0x39); B(0xC8); B(0x0F); B(0x92); B(0xC2);// xor edx, edx; cmp eax, ecx; setb dl
+			B(0xC1); B(0xE2); B(9);										// shl edx, 9
+			B(0x41); B(0x09); B(0xD3);									// or r11d, edx
+			B(0x41); B(0x0F); B(0xB7); B(0x52); B(0x14);				// movzx edx, word [r10+20]
+			B(0x81); B(0xE2); D(~(UINT)(BIT_ZERO | BIT_GT | BIT_LT | BIT_NEG));// and edx, ~MASK
+			B(0x44); B(0x09); B(0xDA);									// or edx, r11d
+			B(0x66); B(0x41); B(0x89); B(0x52); B(0x14);				// mov [r10+20], dx
+			break;
+		case JMP:
+			A += T.LEN;
+			N++;
+			exit(T.IMM);
+			END = true;
+			continue;
+		case JB:
+		case JG:
+		case JE:
+		case JNE:{
+			UINT MASK = OP == JB ? BIT_LT : OP == JG ? BIT_GT : BIT_GT | BIT_LT;
+			A += T.LEN;
+			N++;
+			B(0x41); B(0x0F); B(0xB7); B(0x42); B(0x14);				// movzx eax, word [r10+20]
+			B(0xA9); D(MASK);											// test eax, MASK
+			B(0x0F); B(OP == JE ? 0x84 : 0x85);							// jz/jnz TAKEN
+			BYTE *TAKEN = P; D(0);
+			exit(A);
+			UINT REL = P - (TAKEN + 4);
+			memcpy(TAKEN, &REL, 4);
+			exit(T.IMM);
+			END = true;
+			continue;
+		}
+		default:
+			OK = false;
+			break;
+		}
+		if (!OK) break;
+		A += T.LEN;
+		N++;
+	}
+	if (N == 0){
+		HEAT[IP] = 0;
+		return nullptr;
+	}
+	if (!END){
+		exit(A);
+	}
+	// ʣִָбʱԭ, ɽִ
+	UINT REL = P - (FAIL + 4);
+	memcpy(FAIL, &REL, 4);
+	B(0xB8); D(IP);												// mov eax, IP
+	B(0xC3);													// ret
+	memcpy(COUNT1, &N, 4);
+	memcpy(COUNT2, &N, 4);
+	BLOCK *BL = new BLOCK();
+	BL->START = IP;
+	BL->END = A;
+	BL->COUNT = N;
+	BL->ENTRY = ENTRY;
+	BL->CHAIN = CHAIN;
+	USED = P - CODE;
+	BLOCKS[IP] = BL;
+	ALL.push_back(BL);
+	link(BL);
+	return BL;
+#endif
+}
+
+// /رJIT
+void CPU::jit(bool on){
+	delete NATIVE;
+	NATIVE = nullptr;
+	if (!on) return;
+#ifdef VM_JIT_X64
+	NATIVE = new JIT(LENGTH);
+#else
+	printf("JIT unsupported on this host\n");
+#endif
+}
+
+// PC뱾ش, رش˳ʱIP; PCĻ黹ʱԭ
+WORD CPU::enter(WORD PC){
+	BLOCK *BL = NATIVE->lookup(PC);
+	if (!BL){
+		if (!NATIVE->hot(PC)) return PC;
+		BL = NATIVE->compile(*this, PC);
+		if (!BL) return PC;
+	}
+	JCTX ctx;
+	ctx.REG = REG;
+	ctx.RAM = RAM;
+	// شҲexecuteԤ
+	UINT FUEL = CYCLE >= LIMIT ? 0 : LIMIT - CYCLE < JIT_FUEL ? LIMIT - CYCLE : JIT_FUEL;
+	ctx.FUEL = FUEL;
+	ctx.FR = ALU.flags();
+	ctx.RA = ALU.RA;
+	ctx.RB = ALU.RB;
+	ctx.R = ALU.R;
+	PC = ((NATIVE_FN)BL->ENTRY)(&ctx);
+	ALU.RA = ctx.RA;
+	ALU.RB = ctx.RB;
+	ALU.R = ctx.R;
+	ALU.flags(ctx.FR);
+	CYCLE += FUEL - ctx.FUEL;
+	return PC;
+}
+
+// αдʱ϶ӦĻ
+void CPU::discard(WORD ADDR){
+	NATIVE->invalidate(ADDR);
+}
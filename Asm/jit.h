@@ -0,0 +1,72 @@
+#ifndef __JIT_H_
+#define __JIT_H_
+
+#include <string.h>
+#include <list>
+#include <map>
+#include "vm.h"
+
+using namespace std;
+
+// شֻ֧x86-64, ƽ̨jit(true)Ч, ɽִ
+#if defined(__x86_64__) || defined(_M_X64)
+#define VM_JIT_X64
+#endif
+
+#define JIT_HOT			16			// ִжٴκ
+#define JIT_MAX_INST	64			// ÿָ
+#define JIT_CODE_SIZE	0x100000	// شС
+#define JIT_BLOCK_SIZE	0x2000		// 鱾ش
+#define JIT_FUEL		0x10000000	// ÿν뱾شִеָ
+
+// شл, ƫдɵĴ
+struct JCTX{
+	WORD *REG;		// +0
+	BYTE *RAM;		// +8
+	int FUEL;		// +16 ʣִеָ
+	WORD FR;		// +20 ־Ĵ
+	WORD RA, RB, R;	// +22 һĲͽ, ˳ʱдALU
+};
+
+// õĻ
+struct BLOCK{
+	WORD START, END;	// ǵĴֽ[START, END)
+	WORD COUNT;			// ָ
+	BYTE *ENTRY;		// ӽõ
+	BYTE *CHAIN;		// 
+};
+
+typedef WORD(*NATIVE_FN)(JCTX *ctx);
+
+// JIT: JMP/JE/JNE/JB/JGΪȵx86-64,
+// ĴڴCPUREG[]RAM[], ֮ͨ޸ĵתֱ
+class JIT{
+	BYTE *CODE;					// ִд
+	size_t USED;
+	BYTE *RET;					// ׮, δӵתָ
+	BYTE *P;					// ǰдλ
+	vector<BLOCK*> BLOCKS;		// ʼIP
+	vector<WORD> HEAT;			// ڵִд
+	multimap<WORD, BYTE**> SLOTS;// תĿIP -> ĿĲ
+	list<BLOCK*> ALL;
+	void B(BYTE b){ *P++ = b; }
+	void D(UINT d){ memcpy(P, &d, 4); P += 4; }
+	void W(WORD w){ memcpy(P, &w, 2); P += 2; }
+	void exit(WORD TARGET);
+	void link(BLOCK *BL);
+	bool supported(CPU &cpu, const INST &T);
+public:
+	JIT(WORD LENGTH);
+	~JIT();
+	BLOCK *lookup(WORD IP){
+		return IP < BLOCKS.size() ? BLOCKS[IP] : nullptr;
+	}
+	bool hot(WORD IP){
+		return IP < HEAT.size() && ++HEAT[IP] >= JIT_HOT;
+	}
+	BLOCK *compile(CPU &cpu, WORD IP);
+	void invalidate(WORD ADDR);
+	void flush();
+};
+
+#endif
@@ -121,7 +121,10 @@ public:
 		// 
 		words["proc"] = new Word(PROC, "proc");
 		words["endp"] = new Word(ENDP, "endp");
-		words["call"] = new Word(CALL, "call");
+		words["call"] = new Word(CALLPROC, "call");
+		words["ret"] = new Word(RETPROC, "ret");
+		words["enter"] = new Word(ENTERPROC, "enter");
+		words["leave"] = new Word(LEAVEPROC, "leave");
 		// μĴ
 		words["ds"] = new Integer(REG, Reg::DS);
 		words["cs"] = new Integer(REG, Reg::CS);
@@ -1,9 +1,232 @@
 #include "asm.h"
+#include "batch.h"
+#include "aio.h"
+#include "scheduler.h"
+#include "smp.h"
+#include "asm64.h"
+#include "trace.h"
+#include <chrono>
+#include <string.h>
 
-void main(){
+// ÷: Asm                          data.s
+//       Asm -batch 嵥 [߳] [jit|-] []  ִ嵥еĳ, ÿִ(ĬBATCH_BUDGET, 0)
+//       Asm -snapshot ӳ  []  ִӳHALT(ʼ)д,
+//                                       -resumeHALTһָ; ˿0/1ӱ׼/
+//       Asm -resume  [ []]  ӿջִָ, ˿0/1ӱ׼/
+//                                       첽豸/ļ
+//       Asm -sched ӳ  [߳] [ʱƬ]  ӳforkͻ, ɵִ
+//       Asm -smp ӳ               ˹RAMִӳ, ˴Ӷ˿0xFFԼı
+//       Asm -verify ӳ                Уӳֽ, ִ
+//       Asm -aot ӳ Դļ            ӳĴηC++, ɹ-runװ
+//       Asm -run ӳ [AOTģ]         ִӳ, ģʱģִ
+//       Asm -asm64 Դļ ӳ          64λָ(inst.h)Դļ
+//       Asm -run64 ӳ                 ִ64λӳ, ˿0/1ӱ׼/
+//       Asm -trace ӳ ļ [¼]  ִӳ񲢰ļ¼дļ(VM_TRACE)
+//       Asm -trace-decode ļ [ıļ]  Ѹļı
+//       Asm -profile ӳ [ [foldedļ]]  ִӳȵ, ļʱдջ(VM_PROFILE)
+//       Asm -suggest-fusions ӳ []  رճִָӳ, ִгںϵָ(VM_PROFILE)
+void main(int argc, char *argv[]){
 	char a;
 	FILE file;
 	FILE *fp = &file;
+	if (argc > 2 && strcmp(argv[1], "-batch") == 0){
+		Batch batch;
+		if (!batch.manifest(argv[2])) return;
+		batch.jit(argc > 4 && strcmp(argv[4], "jit") == 0);
+		if (argc > 5) batch.budget((UINT)strtoul(argv[5], NULL, 0));
+		double ms = batch.run(argc > 3 ? atoi(argv[3]) : 0);
+		batch.report(stdout);
+		printf("total %.3f ms\n", ms);
+		return;
+	}
+	if (argc > 3 && strcmp(argv[1], "-sched") == 0){
+		CPU *image = new CPU();
+		vector<CPU*> guests;
+		image->init();
+		if (!image->open(argv[2])) return;
+		Scheduler sched(argc > 4 ? atoi(argv[4]) : 0, argc > 5 ? atoi(argv[5]) : SCHED_SLICE);
+		for (int i = atoi(argv[3]); i > 0; i--){
+			CPU *C = image->fork();
+			if (!C) break;
+			guests.push_back(C);
+			sched.spawn(C);
+		}
+		double ms = sched.run();
+		UINT EXITS[EXIT_FAULT + 1] = {};
+		for (size_t i = 0; i < guests.size(); i++){
+			EXITS[guests[i]->status()]++;
+			delete guests[i];
+		}
+		printf("%u guests: halt %u end %u fault %u\n", (UINT)guests.size(), EXITS[EXIT_HALT], EXITS[EXIT_END], EXITS[EXIT_FAULT]);
+		printf("total %.3f ms\n", ms);
+		delete image;
+		return;
+	}
+	if (argc > 2 && strcmp(argv[1], "-verify") == 0){
+		CPU *cpu = new CPU();
+		cpu->init();
+		if (cpu->open(argv[2]) && cpu->verify(stdout)) printf("%s: verified\n", argv[2]);
+		delete cpu;
+		return;
+	}
+	if (argc > 3 && strcmp(argv[1], "-aot") == 0){
+		CPU *cpu = new CPU();
+		cpu->init();
+		if (cpu->open(argv[2]) && (fp = fopen(argv[3], "w")) != NULL){
+			if (!cpu->translate(fp)) printf("write %s failed\n", argv[3]);
+			fclose(fp);
+		}
+		delete cpu;
+		return;
+	}
+	if (argc > 2 && strcmp(argv[1], "-run") == 0){
+		CPU *cpu = new CPU();
+		cpu->init();
+		if (cpu->open(argv[2]) && (argc < 4 || cpu->aot(argv[3]))){
+			chrono::steady_clock::time_point T0 = chrono::steady_clock::now();
+			BYTE EXIT = cpu->execute();
+			double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - T0).count();
+			printf("status %d cycles %u\n", EXIT, cpu->cycles());
+			printf("total %.3f ms\n", ms);
+		}
+		delete cpu;
+		return;
+	}
+	if (argc > 3 && strcmp(argv[1], "-asm64") == 0){
+		Asm64 as;
+		if (as.assemble(argv[2]) && !as.save(argv[3])) printf("write %s failed\n", argv[3]);
+		return;
+	}
+	if (argc > 2 && strcmp(argv[1], "-run64") == 0){
+		CPU64 *cpu = new CPU64();
+		FileDevice in(stdin), out(stdout);
+		cpu->attach(0, &in);
+		cpu->attach(1, &out);
+		if (cpu->open(argv[2])){
+			chrono::steady_clock::time_point T0 = chrono::steady_clock::now();
+			BYTE EXIT = cpu->execute();
+			double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - T0).count();
+			out.flush();
+			printf("status %d cycles %u\n", EXIT, cpu->cycles());
+			printf("total %.3f ms\n", ms);
+		}
+		delete cpu;
+		return;
+	}
+	if (argc > 3 && strcmp(argv[1], "-smp") == 0){
+		CPU *boot = new CPU();
+		boot->init();
+		if (!boot->open(argv[2])) return;
+		double ms;
+		{
+			SMP smp(boot, atoi(argv[3]));
+			ms = smp.run();
+			for (int i = 0; i < smp.count(); i++)
+				printf("core %d: status %d cycles %u\n", i, smp.core(i)->status(), smp.core(i)->cycles());
+		}
+		printf("total %.3f ms\n", ms);
+		delete boot;
+		return;
+	}
+	if (argc > 3 && strcmp(argv[1], "-trace") == 0){
+#ifdef VM_TRACE
+		CPU *cpu = new CPU();
+		cpu->init();
+		cpu->tracing(argc > 4 ? atoi(argv[4]) : 0x10000);
+		if (cpu->open(argv[2])){
+			cpu->execute();
+			if ((fp = fopen(argv[3], "wb")) != NULL){
+				cpu->dump(fp);
+				fclose(fp);
+			}else{
+				printf("can't create %s\n", argv[3]);
+			}
+		}
+		delete cpu;
+#else
+		printf("-trace needs a build with VM_TRACE\n");
+#endif
+		return;
+	}
+	if (argc > 2 && strcmp(argv[1], "-trace-decode") == 0){
+		FILE *in = fopen(argv[2], "rb");
+		FILE *out = argc > 3 ? fopen(argv[3], "w") : stdout;
+		if (!in || !out){
+			printf("can't open %s\n", in ? argv[3] : argv[2]);
+		}else{
+			trace_decode(in, out);
+		}
+		if (in) fclose(in);
+		if (out && out != stdout) fclose(out);
+		return;
+	}
+	if (argc > 2 && (strcmp(argv[1], "-profile") == 0 || strcmp(argv[1], "-suggest-fusions") == 0)){
+#ifdef VM_PROFILE
+		bool SUGGEST = strcmp(argv[1], "-suggest-fusions") == 0;
+		int TOP = argc > 3 ? atoi(argv[3]) : 20;
+		CPU *cpu = new CPU();
+		cpu->init();
+		// ͳںϺѡʱδںϵִָ
+		if (SUGGEST) cpu->fusion("none");
+		if (cpu->open(argv[2])){
+			BYTE EXIT = cpu->execute();
+			printf("status %d cycles %u\n", EXIT, cpu->cycles());
+			if (SUGGEST){
+				cpu->suggest(stdout, TOP);
+			}else{
+				cpu->hotspots(stdout, TOP);
+				if (argc > 4 && (fp = fopen(argv[4], "w")) != NULL){
+					cpu->flamegraph(fp);
+					fclose(fp);
+				}
+			}
+		}
+		delete cpu;
+#else
+		printf("%s needs a build with VM_PROFILE\n", argv[1]);
+#endif
+		return;
+	}
+	if (argc > 3 && strcmp(argv[1], "-snapshot") == 0){
+		CPU *cpu = new CPU();
+		FileDevice in(stdin), out(stdout);
+		cpu->init();
+		cpu->attach(0, &in);
+		cpu->attach(1, &out);
+		if (cpu->open(argv[2])){
+			BYTE EXIT = cpu->execute(argc > 4 ? (UINT)strtoul(argv[4], NULL, 0) : BUDGET_ALL);
+			out.flush();
+			if (EXIT == EXIT_FAULT){
+				printf("fault at %04x, no snapshot written\n", cpu->ip());
+			}else if (cpu->snapshot(argv[3])){
+				printf("status %d cycles %u\n", EXIT, cpu->cycles());
+			}
+		}
+		delete cpu;
+		return;
+	}
+	if (argc > 2 && strcmp(argv[1], "-resume") == 0){
+		CPU *cpu = new CPU();
+		FileDevice in(stdin), out(stdout);
+		Device *IN = &in, *OUT = &out;
+		if (argc > 3) IN = new AsyncDevice(argv[3], "r");
+		if (argc > 4) OUT = new AsyncDevice(argv[4], "w");
+		cpu->attach(0, IN);
+		cpu->attach(1, OUT);
+		if (cpu->restore(argv[2])){
+			cpu->execute();
+			while (Device *D = cpu->waiting()){
+				D->wait();
+				cpu->execute();
+			}
+			OUT->flush();
+			cpu->store();
+		}
+		delete cpu;
+		if (IN != &in) delete IN;
+		if (OUT != &out) delete OUT;
+		return;
+	}
 	// Ŀ
 	Asm Asm("data.s");
 	printf("﷨ʼ\n");
@@ -11,19 +234,21 @@ void main(){
 	printf("﷨\n");
 	printf("࿪ʼ\n");
 	printf("line  width offset\n");
-	fopen_s(&fp, "data.bin", "w");
+	fopen_s(&fp, "data.bin", "wb");
 	Asm.write(fp);
 	fclose(fp);
 	printf("\n");
-	// ִ
+	// ִ, ӦִеHALT
 	printf("ִ\n");
-	//CPU CPU;
-	//CPU.init();
-	//fopen_s(&fp, "data.bin", "r");
-	//CPU.load(fp);
-	//fclose(fp);
-	//CPU.execute();
-	//CPU.store();
+	CPU *cpu = new CPU();
+	cpu->init();
+	fopen_s(&fp, "data.bin", "rb");
+	cpu->load(fp);
+	fclose(fp);
+	BYTE EXIT = cpu->execute();
+	cpu->store();
+	if (EXIT != EXIT_HALT) printf("status %d at %04x\n", EXIT, cpu->ip());
+	delete cpu;
 	printf("ִн\n");
 	cin >> a;
 }
\ No newline at end of file
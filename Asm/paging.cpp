@@ -0,0 +1,92 @@
+#include "vm.h"
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+Paging::Paging(Paging &P){
+	lock_guard<mutex> G(P.LOCK);
+	LIMIT = P.LIMIT;
+	for (unordered_map<UINT, BYTE*>::iterator it = P.PAGES.begin(); it != P.PAGES.end(); ++it){
+		BYTE *B = (BYTE*)malloc(FAR_PAGE);
+		if (!B) break;
+		memcpy(B, it->second, FAR_PAGE);
+		PAGES[it->first] = B;
+	}
+}
+
+Paging::~Paging(){
+	for (unordered_map<UINT, BYTE*>::iterator it = PAGES.begin(); it != PAGES.end(); ++it){
+		free(it->second);
+	}
+}
+
+BYTE *Paging::page(UINT N, bool ALLOC){
+	lock_guard<mutex> G(LOCK);
+	unordered_map<UINT, BYTE*>::iterator it = PAGES.find(N);
+	if (it != PAGES.end()) return it->second;
+	if (!ALLOC || PAGES.size() >= LIMIT) return nullptr;
+	BYTE *B = (BYTE*)calloc(1, FAR_PAGE);
+	if (B) PAGES[N] = B;
+	return B;
+}
+
+size_t Paging::committed(){
+	lock_guard<mutex> G(LOCK);
+	return PAGES.size();
+}
+
+void Paging::limit(UINT PAGES){
+	lock_guard<mutex> G(LOCK);
+	LIMIT = PAGES;
+}
+
+UINT Paging::limit(){
+	lock_guard<mutex> G(LOCK);
+	return LIMIT;
+}
+
+vector<UINT> Paging::numbers(){
+	vector<UINT> N;
+	{
+		lock_guard<mutex> G(LOCK);
+		for (unordered_map<UINT, BYTE*>::iterator it = PAGES.begin(); it != PAGES.end(); ++it){
+			N.push_back(it->first);
+		}
+	}
+	sort(N.begin(), N.end());
+	return N;
+}
+
+// TLBδʱҳTLB; 0ֱӳ䵽RAM
+bool CPU::walk(UINT N, bool ALLOC){
+	BYTE *P;
+	if (N < FAR_PN(1, 0)){
+		P = RAM + (N << FAR_SHIFT);
+	}else{
+		if (!PAGING){
+			if (!ALLOC) return false;
+			PAGING.reset(new Paging());
+		}
+		P = PAGING->page(N, ALLOC);
+		if (!P) return false;
+	}
+	TLB[N % TLB_SIZE].TAG = N;
+	TLB[N % TLB_SIZE].PAGE = P;
+	return true;
+}
+
+void CPU::flush(){
+	for (int i = 0; i < TLB_SIZE; i++){
+		TLB[i].TAG = ~0u;
+		TLB[i].PAGE = nullptr;
+	}
+}
+
+// ԶڴPAGESҳ, ѷĲջ; Ϊ0ʱдԶڴ(0)EXIT_FAULTͣ
+void CPU::paging(UINT PAGES){
+	if (PAGING){
+		PAGING->limit(PAGES);
+	}else{
+		PAGING.reset(new Paging(PAGES));
+	}
+}
@@ -0,0 +1,47 @@
+#ifndef __PAGING_H_
+#define __PAGING_H_
+
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+#include "code.h"
+
+using namespace std;
+
+// Զڴ: "κ:ƫ"Ѱַ, ÿ64K, ԵַΪκ << 16 | ƫ, 4G
+// 0RAM, Ķΰҳϡ, ֻдҳռڴ
+#define FAR_PAGE		0x1000				// ҳС
+#define FAR_SHIFT		12
+#define FAR_LIMIT		0x10000				// Ĭҳ(256M)
+#define TLB_SIZE		32					// TLB, ֱӳ
+
+// ҳ: κ << 4 | ҳ
+#define FAR_PN(seg, off)	((UINT)(seg) << (16 - FAR_SHIFT) | (WORD)(off) >> FAR_SHIFT)
+
+// TLB, ֻѷҳ, TAGΪҳ
+struct TLB_ENTRY{
+	UINT TAG;
+	BYTE *PAGE;
+};
+
+// ҳ, ִʱ˹, Ͳڽ; ҳֱƶҲͷ
+class Paging{
+	mutex LOCK;
+	unordered_map<UINT, BYTE*> PAGES;	// ҳŵҳ
+	UINT LIMIT;							// ҳ
+public:
+	Paging(UINT LIMIT = FAR_LIMIT) : LIMIT(LIMIT){}
+	Paging(Paging &P);					// ȫѷҳ, forkʹ
+	Paging &operator=(const Paging&) = delete;
+	~Paging();
+	// ҳNӦҳ; δʱALLOCǷ, 򳬳޶ʱؿ
+	BYTE *page(UINT N, bool ALLOC);
+	// ѷҳ
+	size_t committed();
+	void limit(UINT PAGES);
+	UINT limit();
+	// ѷҳҳ, С
+	vector<UINT> numbers();
+};
+
+#endif
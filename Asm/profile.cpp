@@ -0,0 +1,108 @@
+#include "vm.h"
+#include <algorithm>
+
+#ifdef VM_PROFILE
+// ȡָʱ: ͳƲIP, ¼һתǷ, άӰӵջڲ
+// ÷: VM_PROFILE, װ벢ִгhotspots/flamegraph
+void CPU::profile(const INST *I){
+	WORD ADDR = (WORD)(I - ICACHE.data());
+	if (BRANCH >= 0){
+		if (ADDR == ICACHE[BRANCH].IMM){
+			TAKEN[BRANCH]++;
+		}else{
+			FALLS[BRANCH]++;
+		}
+		BRANCH = -1;
+	}
+	OPS[I->OP]++;
+	HITS[ADDR]++;
+	switch (I->OP){
+	case JB:
+	case JG:
+	case JE:
+	case JNE:
+	case F_AJ:
+		BRANCH = ADDR;
+		break;
+	case PUSH:
+		if (I->RA == Reg::BP) frame(ADDR);
+		break;
+	case POP:
+		if (I->RA == Reg::BP) unframe();
+		break;
+	case CALL:
+		frame(I->IMM);
+		break;
+	case RET:
+		unframe();
+		break;
+	}
+	if (++TICK % PROFILE_PERIOD == 0){
+		FRAMES.push_back(ADDR);
+		STACKS[FRAMES]++;
+		FRAMES.pop_back();
+	}
+	ngram(I);
+}
+
+// һ, IDʶò(push $bpIPCALLĿ)
+void CPU::frame(WORD ID){
+	if (FRAMES.size() < PROFILE_DEPTH){
+		FRAMES.push_back(ID);
+	}
+}
+
+void CPU::unframe(){
+	if (!FRAMES.empty()){
+		FRAMES.pop_back();
+	}
+}
+
+// ִд, ִtopIP, Լתĳ
+void CPU::hotspots(FILE *fp, int top){
+	vector<pair<UINT, int> > ranks;
+	UINT TOTAL = 0;
+	for (int OP = 0; OP < 0x100; OP++){
+		TOTAL += OPS[OP];
+		if (OPS[OP]) ranks.push_back(make_pair(OPS[OP], OP));
+	}
+	sort(ranks.rbegin(), ranks.rend());
+	fprintf(fp, "opcode     count      %%\n");
+	for (int i = 0; i < (int)ranks.size(); i++){
+		fprintf(fp, "%-10s %-10u %5.2f\n", opname(ranks[i].second).c_str(), ranks[i].first,
+			100.0 * ranks[i].first / TOTAL);
+	}
+	ranks.clear();
+	for (int A = 0; A < (int)HITS.size(); A++){
+		if (HITS[A]) ranks.push_back(make_pair(HITS[A], A));
+	}
+	sort(ranks.rbegin(), ranks.rend());
+	fprintf(fp, "\nip    count      %%     opcode\n");
+	for (int i = 0; i < top && i < (int)ranks.size(); i++){
+		fprintf(fp, "%04x  %-10u %5.2f %s\n", ranks[i].second, ranks[i].first,
+			100.0 * ranks[i].first / TOTAL, opname(ICACHE[ranks[i].second].OP).c_str());
+	}
+	fprintf(fp, "\nbranch taken      not-taken  taken%%\n");
+	for (int A = 0; A < (int)TAKEN.size(); A++){
+		if (TAKEN[A] + FALLS[A] == 0) continue;
+		fprintf(fp, "%04x   %-10u %-10u %5.2f\n", A, TAKEN[A], FALLS[A],
+			100.0 * TAKEN[A] / (TAKEN[A] + FALLS[A]));
+	}
+}
+
+// folded stackʽջ, ֱӽflamegraph.pl:
+// ÿ"root;bp@1;bp@2;IP: "
+void CPU::flamegraph(FILE *fp){
+	map<vector<WORD>, UINT>::iterator iter;
+	for (iter = STACKS.begin(); iter != STACKS.end(); iter++){
+		const vector<WORD> &S = iter->first;
+		fprintf(fp, "root");
+		for (int i = 0; i + 1 < (int)S.size(); i++){
+			fprintf(fp, ";bp@%04x", S[i]);
+		}
+		string name = opname(ICACHE[S.back()].OP);
+		replace(name.begin(), name.end(), ' ', '_');
+		fprintf(fp, ";%04x:%s %u\n", S.back(), name.c_str(), iter->second);
+	}
+}
+#endif
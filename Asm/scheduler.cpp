@@ -0,0 +1,100 @@
+#include "scheduler.h"
+#include <thread>
+#include <chrono>
+
+Scheduler::Scheduler(int THREADS, UINT SLICE) : SLICE(SLICE), LIVE(0), NEXT(0), STOP(false){
+	if (THREADS <= 0) THREADS = thread::hardware_concurrency();
+	if (THREADS <= 0) THREADS = 1;
+	for (int i = 0; i < THREADS; i++){
+		QUEUES.push_back(new RUNQ());
+	}
+}
+
+Scheduler::~Scheduler(){
+	for (size_t i = 0; i < QUEUES.size(); i++){
+		delete QUEUES[i];
+	}
+}
+
+// ¿ͻָ߳
+void Scheduler::spawn(CPU *cpu){
+	RUNQ *Q = QUEUES[NEXT++ % QUEUES.size()];
+	LIVE++;
+	lock_guard<mutex> guard(Q->LOCK);
+	Q->READY.push_back(cpu);
+}
+
+// ȡһͻ: ȡԼ׵, ûʱ̵߳Ķβȡ
+bool Scheduler::take(int ID, CPU *&C){
+	int N = QUEUES.size();
+	for (int k = 0; k < N; k++){
+		RUNQ *Q = QUEUES[(ID + k) % N];
+		lock_guard<mutex> guard(Q->LOCK);
+		if (Q->READY.empty()) continue;
+		if (k == 0){
+			C = Q->READY.front();
+			Q->READY.pop_front();
+		}else{
+			C = Q->READY.back();
+			Q->READY.pop_back();
+		}
+		return true;
+	}
+	return false;
+}
+
+// 豸Ѿ(򲻻֪ͨ)ʱֱŻضβ
+void Scheduler::park(RUNQ *Q, CPU *C){
+	Device *D = C->waiting();
+	PARK *P = new PARK{ this, Q, C };
+	if (D && D->arm(wake, P)) return;
+	delete P;
+	lock_guard<mutex> guard(Q->LOCK);
+	Q->READY.push_back(C);
+}
+
+void Scheduler::wake(void *ARG){
+	PARK *P = (PARK*)ARG;
+	{
+		lock_guard<mutex> guard(P->QUEUE->LOCK);
+		P->QUEUE->READY.push_back(P->GUEST);
+	}
+	delete P;
+}
+
+void Scheduler::worker(int ID){
+	RUNQ *Q = QUEUES[ID];
+	CPU *C;
+	while (LIVE > 0 && !STOP){
+		if (!take(ID, C)){
+			this_thread::sleep_for(chrono::microseconds(SCHED_IDLE_US));
+			continue;
+		}
+		switch (C->execute(SLICE)){
+		case EXIT_BUDGET:{
+			lock_guard<mutex> guard(Q->LOCK);
+			Q->READY.push_back(C);
+			break;
+		}
+		case EXIT_WAIT:
+			park(Q, C);
+			break;
+		default:
+			LIVE--;
+			break;
+		}
+	}
+}
+
+double Scheduler::run(){
+	vector<thread> POOL;
+	STOP = false;
+	chrono::steady_clock::time_point T0 = chrono::steady_clock::now();
+	for (size_t i = 0; i < QUEUES.size(); i++){
+		POOL.push_back(thread(&Scheduler::worker, this, (int)i));
+	}
+	for (size_t i = 0; i < POOL.size(); i++){
+		POOL[i].join();
+	}
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - T0).count();
+}
@@ -0,0 +1,61 @@
+#ifndef __SCHEDULER_H_
+#define __SCHEDULER_H_
+
+#include <stdio.h>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include "vm.h"
+
+using namespace std;
+
+#define SCHED_SLICE		10000	// ĬʱƬ()
+#define SCHED_IDLE_US	200		// ûпеĿͻʱߵ΢
+
+// ̵߳ж: ԼӶȡʱƬŻضβ, ̴߳Ӷβȡ
+struct RUNQ{
+	mutex LOCK;
+	deque<CPU*> READY;
+};
+
+class Scheduler;
+
+// Ŀͻ: ǼǸ豸, 豸ʱI/O̷߳Żع̵߳Ķ
+struct PARK{
+	Scheduler *OWNER;
+	RUNQ *QUEUE;
+	CPU *GUEST;
+};
+
+// M:N: ̶Ĺִ߳дͻCPU, ÿִһʱƬ
+// ʱƬĿͻŵβ, ȴI/OĿͻռ߳, ̴߳߳ȡ
+// Ŀͻκζ, 豸arm֪ͨ, ȵĿĿͻ޹
+// CPUɵ, runغɲ鿴Եstatus(); ͻ̼߳Ǩ, 豸ɶͻ
+// stopʱԹĿͻԺ󱻻ѷŻض, 豸Ҫڵ
+class Scheduler{
+	vector<RUNQ*> QUEUES;
+	UINT SLICE;
+	atomic<size_t> LIVE;		// δĿͻ
+	atomic<size_t> NEXT;		// һ¿ͻָĸ߳
+	atomic<bool> STOP;
+	bool take(int ID, CPU *&C);
+	void park(RUNQ *Q, CPU *C);
+	static void wake(void *ARG);
+	void worker(int ID);
+public:
+	Scheduler(int THREADS = 0, UINT SLICE = SCHED_SLICE);
+	~Scheduler();
+	// һͻ, run֮ǰжԵ
+	void spawn(CPU *cpu);
+	// ִепͻ(HALT/END/FAULT)stop, ǽʱ()
+	double run();
+	void stop(){
+		STOP = true;
+	}
+	size_t live() const{
+		return LIVE;
+	}
+};
+
+#endif
@@ -0,0 +1,68 @@
+#include "smp.h"
+#include <thread>
+#include <chrono>
+#include <string.h>
+
+// 뵱ǰʵRAMԶڴº, ĴIP뵱ǰʵͬ; 豸, Ҫʱattach
+CPU *CPU::core(WORD ID){
+	CPU *C = new CPU();
+	ram_free(C->RAM);
+	C->RAM = RAM;
+	C->OWN = false;
+	memcpy(C->REG, REG, sizeof(REG));
+	C->SP = SP; C->BP = BP; C->SI = SI; C->DI = DI;
+	C->CS = CS; C->DS = DS; C->ES = ES; C->SS = SS;
+	memcpy(C->PORT, PORT, sizeof(PORT));
+	C->PORT[PORT_CORE] = ID;
+	if (!PAGING) PAGING.reset(new Paging());
+	C->PAGING = PAGING;
+	C->LENGTH = LENGTH;
+	C->FUSE = FUSE;
+	if (NATIVE) C->jit(true);
+	C->prepare();
+	C->IP = IP;
+	C->RSP = RSP;
+	memcpy(C->RSTACK, RSTACK, RSP * sizeof(WORD));
+	C->VERIFIED = VERIFIED;
+	C->GUARD = GUARD;
+	if (AOTFN) C->aot(AOTPATH.c_str());
+	C->ALU = ALU;
+	return C;
+}
+
+SMP::SMP(CPU *BOOT, int N){
+	BOOT->PORT[PORT_CORE] = 0;
+	BOOT->DEVICE[PORT_CORE] = nullptr;
+	CORES.push_back(BOOT);
+	for (int i = 1; i < N; i++){
+		CORES.push_back(BOOT->core(i));
+	}
+}
+
+SMP::~SMP(){
+	for (size_t i = 1; i < CORES.size(); i++){
+		delete CORES[i];
+	}
+}
+
+// ȴ豸ʱڱ߳, Ӱ
+void SMP::worker(int ID){
+	CPU *C = CORES[ID];
+	C->execute();
+	while (Device *D = C->waiting()){
+		D->wait();
+		C->execute();
+	}
+}
+
+double SMP::run(){
+	vector<thread> POOL;
+	chrono::steady_clock::time_point T0 = chrono::steady_clock::now();
+	for (size_t i = 0; i < CORES.size(); i++){
+		POOL.push_back(thread(&SMP::worker, this, (int)i));
+	}
+	for (size_t i = 0; i < POOL.size(); i++){
+		POOL[i].join();
+	}
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - T0).count();
+}
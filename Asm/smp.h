@@ -0,0 +1,30 @@
+#ifndef __SMP_H_
+#define __SMP_H_
+
+#include <stdio.h>
+#include <vector>
+#include "vm.h"
+
+using namespace std;
+
+// ִ: װĺ, ˹˵RAM, мĴԤ뻺
+// ÿԼ߳ϴͬһIPʼִ, IN $r PORT_COREźԷֹ
+// ֮ͨCAS/XADD/FENCEͬ, ͨLOAD/STOREֻFENCE; ֻڸԼĻ, ʱҪд
+class SMP{
+	vector<CPU*> CORES;
+	void worker(int ID);
+public:
+	// BOOTװ, ɵ, SMP֮
+	SMP(CPU *BOOT, int N);
+	~SMP();
+	// кִеͣ, ǽʱ()
+	double run();
+	CPU *core(int ID){
+		return CORES[ID];
+	}
+	int count() const{
+		return (int)CORES.size();
+	}
+};
+
+#endif
@@ -0,0 +1,65 @@
+#include "trace.h"
+#include "vm.h"
+
+// ȡСSIZE2
+TraceRing::TraceRing(size_t SIZE){
+	size_t N = 1;
+	while (N < SIZE){
+		N <<= 1;
+	}
+	BUF.resize(N);
+	MASK = N - 1;
+	HEAD.store(0);
+}
+
+// ʱ˳ȡеļ¼, شǰǵļ¼;
+// д벢ʱ, ڼ䱻ǵļ¼Ҳᶪ
+size_t TraceRing::snapshot(vector<TRACE_REC> &RECS) const{
+	size_t END = total();
+	size_t START = END > BUF.size() ? END - BUF.size() : 0;
+	RECS.clear();
+	for (size_t i = START; i < END; i++){
+		RECS.push_back(BUF[i & MASK]);
+	}
+	// д߿дһ¼, ڵĲҲ
+	size_t NOW = total() + 1;
+	if (NOW > BUF.size() && NOW - BUF.size() > START){
+		size_t DROP = NOW - BUF.size() - START;
+		if (DROP > RECS.size()) DROP = RECS.size();
+		RECS.erase(RECS.begin(), RECS.begin() + DROP);
+		START += DROP;
+	}
+	return START;
+}
+
+void TraceRing::dump(FILE *fp) const{
+	vector<TRACE_REC> RECS;
+	TRACE_HEAD H;
+	H.MAGIC = TRACE_MAGIC;
+	H.LOST = (UINT)snapshot(RECS);
+	H.COUNT = (UINT)RECS.size();
+	fwrite(&H, sizeof(H), 1, fp);
+	if (!RECS.empty()){
+		fwrite(RECS.data(), sizeof(TRACE_REC), RECS.size(), fp);
+	}
+}
+
+bool trace_decode(FILE *in, FILE *out){
+	TRACE_HEAD H;
+	TRACE_REC R;
+	if (fread(&H, sizeof(H), 1, in) != 1 || H.MAGIC != TRACE_MAGIC){
+		printf("not a trace file\n");
+		return false;
+	}
+	fprintf(out, "%u records, %u lost\n", H.COUNT, H.LOST);
+	fprintf(out, "CYCLE IP   OP        RA  RB  RC  IMM   FR   NEXT\n");
+	for (UINT i = 0; i < H.COUNT; i++){
+		if (fread(&R, sizeof(R), 1, in) != 1){
+			printf("trace truncated at record %u\n", i);
+			return false;
+		}
+		fprintf(out, "%-5u %04x %-9s %-3u %-3u %-3u %-5u %04x %04x\n",
+			R.CYCLE, R.IP, opname(R.OP).c_str(), R.RA, R.RB, R.RC, R.IMM, R.FR, R.NEXT);
+	}
+	return true;
+}
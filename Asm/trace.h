@@ -0,0 +1,57 @@
+#ifndef __TRACE_H_
+#define __TRACE_H_
+
+#include <stdio.h>
+#include <atomic>
+#include <vector>
+#include "code.h"
+
+using namespace std;
+
+// ִи: VM_TRACEʱ, CPU::tracing(n)ʱ, ÿִһָ׷һ¼;
+// δVM_TRACEʱٴȫ, Ӱִٶ
+
+// һټ¼
+struct TRACE_REC{
+	UINT CYCLE;		// ִ
+	WORD IP;		// ַָ
+	BYTE OP;		// ԤĲֽ, ָΪF_XXX
+	BYTE RA, RB, RC;// Ĵ
+	WORD IMM;		// /ַ/תĿ
+	WORD FR;		// ִкı־Ĵ
+	WORD NEXT;		// һַָ
+};
+
+// ļʽ: ļͷʱ˳еļ¼
+#define TRACE_MAGIC		0x52544D56	// "VMTR"
+
+struct TRACE_HEAD{
+	UINT MAGIC;
+	UINT COUNT;		// ¼
+	UINT LOST;		// ǵľɼ¼
+};
+
+// λ: ִֻ߳д, д󸲸ɵļ¼;
+// ߳̿ʱsnapshotȡȻЧļ¼
+class TraceRing{
+	vector<TRACE_REC> BUF;
+	size_t MASK;
+	atomic<size_t> HEAD;		// дļ¼
+public:
+	TraceRing(size_t SIZE);
+	void push(const TRACE_REC &R){
+		size_t H = HEAD.load(memory_order_relaxed);
+		BUF[H & MASK] = R;
+		HEAD.store(H + 1, memory_order_release);
+	}
+	size_t total() const{
+		return HEAD.load(memory_order_acquire);
+	}
+	size_t snapshot(vector<TRACE_REC> &RECS) const;
+	void dump(FILE *fp) const;
+};
+
+// ߽: TraceRing::dumpдĶƸתı
+bool trace_decode(FILE *in, FILE *out);
+
+#endif
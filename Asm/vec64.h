@@ -0,0 +1,153 @@
+#ifndef __VEC64_H_
+#define __VEC64_H_
+
+#include <math.h>
+#include <string.h>
+#include "inst.h"
+
+// 64λָĴ: 256λ, 8Ȼ4˫, ȽϽÿȫ1ȫ0
+// ĴļCPU64, ֤32ֽڶ, һòҪĶд
+// ֧AVX2ʱ256λָ, x86-64SSE2, ƽ̨VEC64_SCALARʱ;
+// ʵֽͬ: FMAֻһ, ˮƽͰ̶Ĵ(ȸ߰ӵͰ, )
+#if defined(VEC64_SCALAR)
+#elif defined(__AVX2__)
+#define VEC64_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VEC64_SSE2
+#include <emmintrin.h>
+#endif
+
+#define VEC64_BYTES		32
+#define VEC64_FLANES	8
+#define VEC64_DLANES	4
+
+union VREG{
+	F4 F[VEC64_FLANES];
+	F8 D[VEC64_DLANES];
+	U4 M[VEC64_FLANES];
+	U8 Q[VEC64_DLANES];
+};
+
+inline void vload(VREG &V, const BYTE *P){
+	memcpy(&V, P, VEC64_BYTES);
+}
+inline void vstore(BYTE *P, const VREG &V){
+	memcpy(P, &V, VEC64_BYTES);
+}
+inline void vbroadcast(VREG &V, F4 X){
+	for (int i = 0; i < VEC64_FLANES; i++) V.F[i] = X;
+}
+inline void vbroadcast(VREG &V, F8 X){
+	for (int i = 0; i < VEC64_DLANES; i++) V.D[i] = X;
+}
+
+#if defined(VEC64_AVX2)
+#define VEC64_FOP(name, ps, pd)\
+	inline void name##f(VREG &R, const VREG &A, const VREG &B){\
+		_mm256_storeu_ps(R.F, ps(_mm256_loadu_ps(A.F), _mm256_loadu_ps(B.F)));\
+	}\
+	inline void name##d(VREG &R, const VREG &A, const VREG &B){\
+		_mm256_storeu_pd(R.D, pd(_mm256_loadu_pd(A.D), _mm256_loadu_pd(B.D)));\
+	}
+VEC64_FOP(vadd, _mm256_add_ps, _mm256_add_pd)
+VEC64_FOP(vsub, _mm256_sub_ps, _mm256_sub_pd)
+VEC64_FOP(vmul, _mm256_mul_ps, _mm256_mul_pd)
+inline void vltf(VREG &R, const VREG &A, const VREG &B){
+	_mm256_storeu_ps(R.F, _mm256_cmp_ps(_mm256_loadu_ps(A.F), _mm256_loadu_ps(B.F), _CMP_LT_OQ));
+}
+inline void vltd(VREG &R, const VREG &A, const VREG &B){
+	_mm256_storeu_pd(R.D, _mm256_cmp_pd(_mm256_loadu_pd(A.D), _mm256_loadu_pd(B.D), _CMP_LT_OQ));
+}
+// R = M ? A : B, λѡ
+inline void vselect(VREG &R, const VREG &M, const VREG &A, const VREG &B){
+	__m256i X = _mm256_loadu_si256((const __m256i*)&M);
+	__m256i Y = _mm256_or_si256(_mm256_and_si256(X, _mm256_loadu_si256((const __m256i*)&A)),
+		_mm256_andnot_si256(X, _mm256_loadu_si256((const __m256i*)&B)));
+	_mm256_storeu_si256((__m256i*)&R, Y);
+}
+#elif defined(VEC64_SSE2)
+#define VEC64_FOP(name, ps, pd)\
+	inline void name##f(VREG &R, const VREG &A, const VREG &B){\
+		_mm_storeu_ps(R.F, ps(_mm_loadu_ps(A.F), _mm_loadu_ps(B.F)));\
+		_mm_storeu_ps(R.F + 4, ps(_mm_loadu_ps(A.F + 4), _mm_loadu_ps(B.F + 4)));\
+	}\
+	inline void name##d(VREG &R, const VREG &A, const VREG &B){\
+		_mm_storeu_pd(R.D, pd(_mm_loadu_pd(A.D), _mm_loadu_pd(B.D)));\
+		_mm_storeu_pd(R.D + 2, pd(_mm_loadu_pd(A.D + 2), _mm_loadu_pd(B.D + 2)));\
+	}
+VEC64_FOP(vadd, _mm_add_ps, _mm_add_pd)
+VEC64_FOP(vsub, _mm_sub_ps, _mm_sub_pd)
+VEC64_FOP(vmul, _mm_mul_ps, _mm_mul_pd)
+VEC64_FOP(vlt, _mm_cmplt_ps, _mm_cmplt_pd)
+inline void vselect(VREG &R, const VREG &M, const VREG &A, const VREG &B){
+	for (int i = 0; i < 2; i++){
+		__m128i X = _mm_loadu_si128((const __m128i*)&M + i);
+		__m128i Y = _mm_or_si128(_mm_and_si128(X, _mm_loadu_si128((const __m128i*)&A + i)),
+			_mm_andnot_si128(X, _mm_loadu_si128((const __m128i*)&B + i)));
+		_mm_storeu_si128((__m128i*)&R + i, Y);
+	}
+}
+#else
+#define VEC64_FOP(name, OP)\
+	inline void name##f(VREG &R, const VREG &A, const VREG &B){\
+		for (int i = 0; i < VEC64_FLANES; i++) R.F[i] = A.F[i] OP B.F[i];\
+	}\
+	inline void name##d(VREG &R, const VREG &A, const VREG &B){\
+		for (int i = 0; i < VEC64_DLANES; i++) R.D[i] = A.D[i] OP B.D[i];\
+	}
+VEC64_FOP(vadd, +)
+VEC64_FOP(vsub, -)
+VEC64_FOP(vmul, *)
+inline void vltf(VREG &R, const VREG &A, const VREG &B){
+	for (int i = 0; i < VEC64_FLANES; i++) R.M[i] = A.F[i] < B.F[i] ? ~0u : 0;
+}
+inline void vltd(VREG &R, const VREG &A, const VREG &B){
+	for (int i = 0; i < VEC64_DLANES; i++) R.Q[i] = A.D[i] < B.D[i] ? ~(U8)0 : 0;
+}
+inline void vselect(VREG &R, const VREG &M, const VREG &A, const VREG &B){
+	for (int i = 0; i < VEC64_DLANES; i++) R.Q[i] = (M.Q[i] & A.Q[i]) | (~M.Q[i] & B.Q[i]);
+}
+#endif
+#undef VEC64_FOP
+
+// R += A * B, ֻһ; ûFMAָʱfma
+inline void vfmaf(VREG &R, const VREG &A, const VREG &B){
+#if defined(VEC64_AVX2) && defined(__FMA__)
+	_mm256_storeu_ps(R.F, _mm256_fmadd_ps(_mm256_loadu_ps(A.F), _mm256_loadu_ps(B.F), _mm256_loadu_ps(R.F)));
+#else
+	for (int i = 0; i < VEC64_FLANES; i++) R.F[i] = fmaf(A.F[i], B.F[i], R.F[i]);
+#endif
+}
+inline void vfmad(VREG &R, const VREG &A, const VREG &B){
+#if defined(VEC64_AVX2) && defined(__FMA__)
+	_mm256_storeu_pd(R.D, _mm256_fmadd_pd(_mm256_loadu_pd(A.D), _mm256_loadu_pd(B.D), _mm256_loadu_pd(R.D)));
+#else
+	for (int i = 0; i < VEC64_DLANES; i++) R.D[i] = fma(A.D[i], B.D[i], R.D[i]);
+#endif
+}
+
+// ˮƽ: SIMDĹԼͬ, ʵֽһ
+inline F4 vsumf(const VREG &A){
+#if defined(VEC64_AVX2) || defined(VEC64_SSE2)
+	__m128 X = _mm_add_ps(_mm_loadu_ps(A.F), _mm_loadu_ps(A.F + 4));
+	X = _mm_add_ps(X, _mm_movehl_ps(X, X));
+	X = _mm_add_ss(X, _mm_shuffle_ps(X, X, 1));
+	return _mm_cvtss_f32(X);
+#else
+	F4 X[4];
+	for (int i = 0; i < 4; i++) X[i] = A.F[i] + A.F[i + 4];
+	return (X[0] + X[2]) + (X[1] + X[3]);
+#endif
+}
+inline F8 vsumd(const VREG &A){
+#if defined(VEC64_AVX2) || defined(VEC64_SSE2)
+	__m128d X = _mm_add_pd(_mm_loadu_pd(A.D), _mm_loadu_pd(A.D + 2));
+	X = _mm_add_sd(X, _mm_unpackhi_pd(X, X));
+	return _mm_cvtsd_f64(X);
+#else
+	return (A.D[0] + A.D[2]) + (A.D[1] + A.D[3]);
+#endif
+}
+
+#endif
@@ -0,0 +1,178 @@
+#include "vm.h"
+
+// װʱֽУ: ӵǰIPпܵĿһ, ֤
+//   1. ߵÿָϷ(, δõѰַʽ/λΪ0)ҲԽĩβ
+//   2. תĿ궼ڴ, ˳ִ䵽ĩβ(ڱ)
+//   3. ÿָںڵջ뵽·޹, POPԽڵSP
+//   4. CALLĿ꿪ʼһջ֡, Ϊ0, ͬһöֻһ; RETΪ0, CALL֮Ȳ
+//   5. ENTER nʹ2+nѹ$bp, LEAVEصENTER֮ǰ; Ϊ˺ENTERǶ,
+//      LEAVEǰENTER, ENTERLEAVE֮䲻д$bp, RET$bpʱͬ, CALLǰ$bp
+//   6. صͼĵѹջβཻ; ͼл(ݹ)ʱ޽,
+//      У, ѹջENTERվɼǷд˴(GUARD)
+// صַջǿ(ڵбĿ)ʱջ֡δ֪, У, ķʽִ
+// ĴźͶ˿ںŶһֽ, ĴļͶ˿ڱ0x100, 
+// ͨexecuteʡÿָPCԽѹջʱĴд; ʱ뱻дУ
+
+// ָǷдĴR(ֻдֽ)
+static bool writes(const INST &T, BYTE R){
+	switch (OP_CODE(T.OP)){
+	case ADD: case SUB: case MUL: case DIV: case MOD: case CMP:
+		return T.RC == R;
+	case NEG: case CAS: case XADD:
+		return T.RB == R;
+	case LOAD: case POP: case LOADF:
+		return T.RA == R;
+	case IN:
+		return T.OP & MR_B ? T.RB == R : T.RA == R;
+	case OUT:
+		return (T.OP & MR_B) && T.RB == R;
+	case MOVS: case CMPS:
+		return T.RA == R || T.RB == R || T.RC == R;
+	case STOS:
+		return T.RA == R || T.RC == R;
+	}
+	return false;
+}
+
+struct CALLSITE{
+	WORD FROM, TO;	// ߺͱߵ
+	int D;			// CALLߵջ
+};
+
+// Eصͼջ, LOCAL[E]Ǻ, 󻻳ɽ; лʱ-1
+static int deepest(WORD E, const vector<CALLSITE> &CALLS, vector<int> &LOCAL, vector<char> &MARK){
+	if (MARK[E] == 2) return LOCAL[E];
+	if (MARK[E] == 1) return -1;
+	MARK[E] = 1;
+	int M = LOCAL[E];
+	for (size_t i = 0; i < CALLS.size(); i++){
+		if (CALLS[i].FROM != E) continue;
+		int K = deepest(CALLS[i].TO, CALLS, LOCAL, MARK);
+		if (K < 0) return -1;
+		if (CALLS[i].D + K > M) M = CALLS[i].D + K;
+	}
+	MARK[E] = 2;
+	LOCAL[E] = M;
+	return M;
+}
+
+bool CPU::verify(FILE *log){
+	VERIFIED = false;
+	const char *ERR = nullptr;
+	int AT = IP;
+	vector<int> DEPTH(LENGTH + 1, -1);	// ָںSPջ(ֽ), -1Ϊδߵ
+	vector<int> FRAME(LENGTH + 1, -1);	// ָں
+	vector<int> LOCAL(LENGTH + 1, 0);	// ջ, 
+	vector<CALLSITE> CALLS;
+	vector<int> BASE(LENGTH + 1, -1);	// ָ$bpָ(ENTERѹ$bp), -1Ϊʱ$bp, -2Ϊд
+	vector<WORD> WORK;
+	if (IP < CS || IP > LENGTH){
+		ERR = "entry outside code";
+	}else if (RSP){
+		ERR = "return stack not empty";
+	}else{
+		DEPTH[IP] = 0;
+		FRAME[IP] = IP;
+		WORK.push_back(IP);
+	}
+	while (!ERR && !WORK.empty()){
+		WORD A = WORK.back();
+		WORK.pop_back();
+		if (A == LENGTH) continue;		// ڱ
+		AT = A;
+		INST T;
+		decode(A, T);
+		int D = DEPTH[A], F = FRAME[A], B = BASE[A];
+		BYTE OP = OP_CODE(T.OP);
+		if (T.OP == OP_INVALID){
+			ERR = "invalid opcode";
+		}else if (T.OP != RAM[A]){
+			ERR = "unused mode bits set";
+		}else if (OP == STORE && !(T.OP & MR_B)){
+			ERR = "store without address";
+		}else if (A + T.LEN > LENGTH){
+			ERR = "instruction runs past end of code";
+		}else if (OP == ENTER && B != -1){
+			ERR = B >= 0 ? "nested enter" : "enter after $bp written";
+		}else if (OP == LEAVE && B < 0){
+			ERR = "leave without enter";
+		}else if (OP == RET && B != -1){
+			ERR = B >= 0 ? "ret without leave" : "$bp changed at ret";
+		}else if (OP == RET && D != 0){
+			ERR = "stack depth at ret differs from entry";
+		}else if (B >= 0 && writes(T, Reg::BP)){
+			ERR = "$bp written between enter and leave";
+		}
+		if (ERR) break;
+		if (writes(T, Reg::BP)) B = -2;
+		if (OP == PUSH){
+			D += T.OP & MR_BYTE ? 1 : 2;
+			if (D > LOCAL[F]) LOCAL[F] = D;
+		}else if (OP == POP){
+			D -= T.OP & MR_BYTE ? 1 : 2;
+			if (D < 0){
+				ERR = "stack underflow";
+				break;
+			}
+		}else if (OP == ENTER){
+			D += 2;
+			B = D;
+			D += T.IMM;
+			if (D > LOCAL[F]) LOCAL[F] = D;
+		}else if (OP == LEAVE){
+			D = B - 2;
+			B = -1;
+		}
+		// : HALT/RETû, JMPֻĿ, תCALLĿһ, ֻһ
+		// CALLĿµջ֡, Ϊ0, ûENTER
+		int NEXT[2], ND[2], NF[2], NB[2], N = 0;
+		if (OP == JMP || OP == JB || OP == JG || OP == JE || OP == JNE || OP == CALL){
+			if (T.IMM < CS || T.IMM > LENGTH){
+				ERR = "jump target outside code";
+				break;
+			}
+			if (OP == CALL){
+				CALLSITE C = { (WORD)F, T.IMM, D };
+				CALLS.push_back(C);
+			}
+			ND[N] = OP == CALL ? 0 : D;
+			NF[N] = OP == CALL ? T.IMM : F;
+			NB[N] = OP == CALL ? -1 : B;
+			NEXT[N++] = T.IMM;
+		}
+		if (OP != HALT && OP != JMP && OP != RET){
+			ND[N] = D;
+			NF[N] = F;
+			NB[N] = B;
+			NEXT[N++] = A + T.LEN;
+		}
+		for (int k = 0; k < N; k++){
+			if (DEPTH[NEXT[k]] < 0){
+				DEPTH[NEXT[k]] = ND[k];
+				FRAME[NEXT[k]] = NF[k];
+				BASE[NEXT[k]] = NB[k];
+				WORK.push_back(NEXT[k]);
+			}else if (DEPTH[NEXT[k]] != ND[k] || FRAME[NEXT[k]] != NF[k] || BASE[NEXT[k]] != NB[k]){
+				ERR = "stack depth differs between paths";
+				break;
+			}
+		}
+	}
+	// ѹջд[SP - MAXD + 1, SP], ƻҲ
+	vector<char> MARK(LENGTH + 1, 0);
+	int MAXD = ERR ? 0 : deepest(IP, CALLS, LOCAL, MARK);
+	GUARD = MAXD < 0;
+	if (MAXD > 0){
+		int LOW = SP - MAXD + 1;
+		if (LOW < 0 || (LOW < LENGTH && SP >= CS)){
+			ERR = "stack overlaps code";
+			AT = SP;
+		}
+	}
+	if (ERR){
+		if (log) fprintf(log, "verify: %04x: %s\n", AT, ERR);
+		return false;
+	}
+	VERIFIED = true;
+	return true;
+}
@@ -1,209 +1,837 @@
 #include "vm.h"
+#include <string.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 void CPU::init(){
+	memset(REG, 0, sizeof(REG));
 	DS = CS = BP = IP = 0;
 	SS = 0xffff;// ջַ
 	SP = SS;// ջָ
 }
+// װӳԤ, κϢ; ӳʱfalse
+bool CPU::read(FILE *fp){
+	bool OK = true;
+	OK = OK && fread(&DS, sizeof(WORD), 1, fp) == 1;
+	OK = OK && fread(&CS, sizeof(WORD), 1, fp) == 1;
+	OK = OK && fread(&SS, sizeof(WORD), 1, fp) == 1;
+	OK = OK && fread(&LENGTH, sizeof(WORD), 1, fp) == 1;
+	OK = OK && fread(RAM, sizeof(BYTE)* LENGTH, 1, fp) == 1;
+	prepare();
+	IP = CS;
+	if (OK) verify();
+	return OK;
+}
+// ڴӳԤ, һ״̬
+void CPU::prepare(){
+	ICACHE.assign(LENGTH + 1, INST());
+	for (int A = 0; A < LENGTH; A++){
+		decode(A);
+	}
+	ICACHE[LENGTH].OP = OP_END;
+	VERIFIED = false;
+	RSP = 0;
+	if (NATIVE) jit(true);
+#ifdef VM_PROFILE
+	HITS.assign(LENGTH + 1, 0);// ڱ
+	TAKEN.assign(LENGTH + 1, 0);
+	FALLS.assign(LENGTH + 1, 0);
+	BRANCH = -1;
+	FRAMES.clear();
+#endif
+	EXIT = EXIT_NONE;
+}
 void CPU::load(FILE *fp){
-	fread(&DS, sizeof(WORD), 1, fp);
-	fread(&CS, sizeof(WORD), 1, fp);
-	fread(&SS, sizeof(WORD), 1, fp);
-	fread(&LENGTH, sizeof(WORD), 1, fp);
-	fread(&RAM, sizeof(BYTE)* LENGTH, 1, fp);
+	read(fp);
 	printf("DS:%04d,CS:%04d,LENGTH:%04d\n", DS, CS, LENGTH);
-	printf("START\t[CYCLE:%04d DS:%04d CS:%04d IP:%04x]", CYCLE, DS, CS, IP);
+	printf("START\t[CYCLE:%04u DS:%04d CS:%04d IP:%04x]", CYCLE, DS, CS, IP);
 	printf("[%4d", RAM[DS]);
 	for (int i = DS + 1; i < CS; i++){
 		printf(" %4d", RAM[i]);
 	}
 	printf("]\n");
-	IP = CS;
 }
 void CPU::store(){
-	printf("END\t[CYCLE:%04d DS:%04d CS:%04d IP:%04x]", CYCLE, DS, CS, IP);
+	printf("END\t[CYCLE:%04u DS:%04d CS:%04d IP:%04x]", CYCLE, DS, CS, IP);
 	printf("[%4d", RAM[DS]);
 	for (int i = DS + 1; i < CS; i++){
 		printf(" %4d", RAM[i]);
 	}
 	printf("]\n");
 }
-void CPU::execute(){
-	WORD ABUS, DBUS;
-	BYTE OP, TYPE, MR;
-	do{ 
-		OP = RAM[IP++];
-		CYCLE++;
-		TYPE = OP & MR_BYTE;
-		MR = OP & MR_B;
-		OP &= (~MR_BYTE);
-		OP &= (~MR_B);
-		switch (OP){
-		case ADD:
-		case SUB:
-		case MUL:
-		case DIV:
-		case MOD:
-		case CMP:
-			ALU.OP = OP;
-			if (TYPE == MR_BYTE){
-				ABUS = ReadB();
-				ALU.RA ^= ALU.RA;
-				ALU.RA |= REG[ABUS];
-				ABUS = ReadB();
-				ALU.RB ^= ALU.RB;
-				ALU.RB |= REG[ABUS];
-				ALU.execute();
-				ABUS = ReadB();
-				REG[ABUS] = ALU.R;
-			}else{
-				ABUS = ReadB();
-				ALU.RA ^= ALU.RA;
-				ALU.RA |= REG[ABUS];
-				ALU.RA |= REG[ABUS + 1] << 8;
-				ABUS = ReadB();
-				ALU.RB ^= ALU.RB;
-				ALU.RB |= REG[ABUS];
-				ALU.RB |= REG[ABUS + 1] << 8;
-				ALU.execute();
-				ABUS = ReadB();
-				REG[ABUS] = ALU.R;
-				REG[ABUS + 1] = ALU.R >> 8;
-			}
-			break;
-		case NEG:
-			ALU.OP = OP;
-			if (TYPE == MR_BYTE){
-				ABUS = ReadB();
-				ALU.RA ^= ALU.RA;
-				ALU.RA |= REG[ABUS];
-				ALU.execute();
-				ABUS = ReadB();
-				REG[ABUS] = ALU.R;
-			}
-			else{
-				ABUS = ReadB();
-				ALU.RA ^= ALU.RA;
-				ALU.RA |= REG[ABUS];
-				ALU.RA |= REG[ABUS + 1] << 8;
-				ALU.execute();
-				ABUS = ReadB();
-				REG[ABUS] = ALU.R;
-				REG[ABUS + 1] = ALU.R >> 8;
-			}
-			break;
-		case JB:
-			if (ALU.FR&BIT_LT){
-				IP = ReadW();
-			}else{
-				IP++; IP++;
-			}
-			break;
-		case JG:
-			if (ALU.FR&BIT_GT){
-				IP = ReadW();
-			}
-			else{
-				IP++; IP++;
-			}
-			break;
-		case JE:
-			if (ALU.FR & (BIT_GT | BIT_LT)){
-				IP++; IP++;
-			}else{
-				IP = ReadW();
-			}
-			break;
-		case JNE:
-			if (ALU.FR & (BIT_GT | BIT_LT)){
-				IP = ReadW();
-			}else{
-				IP++; IP++;
-			}
-			break;
-		case JMP:
-			IP = ReadW();
-			break;
-		case PUSH:
-			ABUS = ReadB();
-			if (TYPE == MR_BYTE){
-				RAM[SP--] = REG[ABUS];
-			}else{
-				RAM[SP--] = REG[ABUS + 1];
-				RAM[SP--] = REG[ABUS];
-			}
-			break;
-		case POP:
-			ABUS = ReadB();
-			if (TYPE == MR_BYTE){
-				REG[ABUS] = RAM[SP++];
-			}else{
-				REG[ABUS] = RAM[SP++];
-				REG[ABUS + 1] = RAM[SP++];
-			}
-			break;
-		case LOAD:
-			ABUS = ReadB();
-			if (TYPE == MR_BYTE){
-				switch (MR){// 01100000
-				case MR_A:DBUS = ReadB(); break;
-				case MR_B:DBUS = ReadB(ReadB());  break;
-				default:printf("ERROR %d\n", OP); break;
-				}
-				REG[ABUS] = DBUS;
-			}else{
-				switch (MR){
-				case MR_A:DBUS = ReadW(); break;
-				case MR_B:DBUS = ReadW(ReadW()); break;
-				default:printf("ERROR %d\n", OP); break;
-				}
-				REG[ABUS] = DBUS;
-				REG[ABUS + 1] = DBUS >> 8;
-			}
-			break;
-		case STORE:
-			ABUS = ReadB();
-			if (TYPE == MR_BYTE){
-				DBUS = REG[ABUS];
-				switch (MR){
-				case MR_B:ABUS = ReadW(); break;
-				default: printf("error storew"); break;
-				}
-				RAM[ABUS] = DBUS;
-			}else{
-				DBUS ^= DBUS;
-				DBUS |= REG[ABUS];
-				DBUS |= REG[ABUS + 1] << 8;
-				switch (MR){
-				case MR_B:ABUS = ReadW(); break;
-				default: printf("error storew"); break;
-				}
-				RAM[ABUS] = DBUS;
-				RAM[ABUS + 1] = DBUS >> 8;
+// ָɺ: ͬһָʵּȿչΪ, ҲչΪswitch
+// PCIPexecuteеľֲ, ٺ˳ǰдIP
+// δУĴ(CHECKED)ÿָǰPCǷԽ; УĴתĿ궼Ϸ,
+// 䵽ĩβʱִICACHE[LENGTH]ڱ, 
+#define RUNOFF()		(CHECKED && PC >= LENGTH)
+#ifdef VM_PROFILE
+#define PROFILE()		profile(I)
+#else
+#define PROFILE()
+#endif
+#define FETCH()			I = &CODE[PC];\
+						PC += I->LEN;\
+						CYCLE++;\
+						PROFILE()
+// ֻVM_TRACE_DEBUG±, ֻ˳ʱдIP
+#if defined(VM_TRACE) || defined(_DEBUG)
+#define TRACE()			IP = PC;\
+						trace(I)
+#else
+#define TRACE()
+#endif
+// תµĻڳԽ뱾ش, ͳƺ͸ʱִֻ
+#if defined(VM_PROFILE)
+#define JIT_ENTER()
+#elif defined(VM_TRACE)
+#define JIT_ENTER()		if (!TRACER){ NATIVE_ENTER(); }
+#else
+#define JIT_ENTER()		NATIVE_ENTER()
+#endif
+// װAOTģʱִģ
+#define NATIVE_ENTER()	if (AOTFN) PC = invoke(PC);\
+						else if (NATIVE) PC = enter(PC)
+// /ֽλѰַʽչĴ
+#define MODE_W			0
+#define MODE_B			MR_BYTE
+#define MODE_WM			MR_B
+#define MODE_BM			(MR_BYTE | MR_B)
+#ifdef VM_THREADED_DISPATCH
+#define OPCASE(op)		L_##op:
+#define OPCASEM(op, m)	L_##op##_##m:
+#define OPDEFAULT		L_INVALID:
+#define BIND(op)		TABLE[op] = &&L_##op
+#define BIND2(op)		TABLE[op | MODE_W] = &&L_##op##_W;\
+						TABLE[op | MODE_B] = &&L_##op##_B
+#define BIND4(op)		BIND2(op);\
+						TABLE[op | MODE_WM] = &&L_##op##_WM;\
+						TABLE[op | MODE_BM] = &&L_##op##_BM
+#define NEXT()			TRACE();\
+						if (RUNOFF() || CYCLE >= LIMIT) goto L_STOP;\
+						FETCH();\
+						goto *TABLE[I->OP]
+#define DISPATCH_BEGIN	if (RUNOFF() || CYCLE >= LIMIT) goto L_STOP;\
+						FETCH();\
+						goto *TABLE[I->OP];
+#define DISPATCH_END	L_STOP:
+#else
+#define OPCASE(op)		case op:
+#define OPCASEM(op, m)	case op | MODE_##m:
+#define OPDEFAULT		default:
+#define NEXT()			break
+#define DISPATCH_BEGIN	while (!RUNOFF() && CYCLE < LIMIT){\
+							FETCH();\
+							switch (I->OP){
+#define DISPATCH_END		}\
+							TRACE();\
+						}
+#endif
+// opڿ/Ѱַʽmµػ
+#define SPECIAL(op, m, H)	OPCASEM(op, m)\
+							H<op | MODE_##m>(I);\
+							NEXT();
+#define SPECIAL2(op, H)		SPECIAL(op, W, H)\
+							SPECIAL(op, B, H)
+#define SPECIAL4(op, H)		SPECIAL2(op, H)\
+							SPECIAL(op, WM, H)\
+							SPECIAL(op, BM, H)
+// ͣµĴ: falseʱ(豸δ/)ָִ, IPͣ, EXIT
+#define STOPPABLE(op, m, H)	OPCASEM(op, m)\
+							if (!H<op | MODE_##m>(I)){\
+								CYCLE--;\
+								IP = PC - I->LEN;\
+								return EXIT;\
+							}\
+							NEXT();
+// ָn; ʣԤ㲻ʱִֻĵһָ, ճ, ԤӲ
+#define FUSED(n)			if (CYCLE + n > LIMIT){\
+								PC = lead(I, PC);\
+								NEXT();\
+							}\
+							CYCLE += n
+#define STOPPABLE2(op, H)	STOPPABLE(op, W, H)\
+							STOPPABLE(op, B, H)
+#define STOPPABLE4(op, H)	STOPPABLE2(op, H)\
+							STOPPABLE(op, WM, H)\
+							STOPPABLE(op, BM, H)
+
+// ADDRָ, ȫI
+// 벻õ/ֽλѰַʽλ, ÿֻֽӦһ
+void CPU::decode(WORD ADDR, INST &I){
+	BYTE OP = RAM[ADDR];
+	I.OP = OP;
+	I.RA = I.RB = I.RC = 0;
+	I.AOP = I.JOP = 0;
+	I.IMM = I.IMM2 = I.IMM3 = 0;
+	switch (OP_CODE(OP)){
+	case ADD:
+	case SUB:
+	case MUL:
+	case DIV:
+	case MOD:
+	case CMP:
+		I.OP = OP & ~MR_B;
+		I.RA = RAM[(WORD)(ADDR + 1)];
+		I.RB = RAM[(WORD)(ADDR + 2)];
+		I.RC = RAM[(WORD)(ADDR + 3)];
+		I.LEN = 4;
+		break;
+	case NEG:
+		I.OP = OP & ~MR_B;
+		I.RA = RAM[(WORD)(ADDR + 1)];
+		I.RB = RAM[(WORD)(ADDR + 2)];
+		I.LEN = 3;
+		break;
+	case JB:
+	case JG:
+	case JE:
+	case JNE:
+	case JMP:
+	case CALL:
+	case ENTER:
+		I.OP = OP_CODE(OP);
+		I.IMM = ReadW(ADDR + 1);
+		I.LEN = 3;
+		break;
+	case PUSH:
+	case POP:
+		I.OP = OP & ~MR_B;
+		I.RA = RAM[(WORD)(ADDR + 1)];
+		I.LEN = 2;
+		break;
+	case LOAD:
+		I.RA = RAM[(WORD)(ADDR + 1)];
+		if (OP & MR_BYTE){// ֽڲֽڵַֻռһֽ
+			I.IMM = RAM[(WORD)(ADDR + 2)];
+			I.LEN = 3;
+		}else{
+			I.IMM = ReadW(ADDR + 2);
+			I.LEN = 4;
+		}
+		break;
+	case STORE:
+		I.RA = RAM[(WORD)(ADDR + 1)];
+		if ((OP & MR_B) == MR_B){
+			I.IMM = ReadW(ADDR + 2);
+			I.LEN = 4;
+		}else{
+			I.IMM = I.RA;// ֵ֧Ѱַʽ, ԭʵһдĴŶӦĵַ
+			I.LEN = 2;
+		}
+		break;
+	case IN:
+	case OUT:
+		I.RA = RAM[(WORD)(ADDR + 1)];
+		if (OP & MR_B){// 鴫: ַĴ ȼĴ ˿
+			I.RB = RAM[(WORD)(ADDR + 2)];
+			I.IMM = RAM[(WORD)(ADDR + 3)];
+			I.LEN = 4;
+		}else{
+			I.IMM = RAM[(WORD)(ADDR + 2)];
+			I.LEN = 3;
+		}
+		break;
+	case CAS:
+		I.OP = OP & ~MR_B;
+		I.RA = RAM[(WORD)(ADDR + 1)];
+		I.RB = RAM[(WORD)(ADDR + 2)];
+		I.RC = RAM[(WORD)(ADDR + 3)];
+		I.LEN = 4;
+		break;
+	case LOADF:
+	case STOREF:
+	case MOVS:
+	case STOS:
+	case CMPS:
+		I.OP = OP & ~MR_B;
+		I.RA = RAM[(WORD)(ADDR + 1)];
+		I.RB = RAM[(WORD)(ADDR + 2)];
+		I.RC = RAM[(WORD)(ADDR + 3)];
+		I.LEN = 4;
+		break;
+	case XADD:
+		I.OP = OP & ~MR_B;
+		I.RA = RAM[(WORD)(ADDR + 1)];
+		I.RB = RAM[(WORD)(ADDR + 2)];
+		I.LEN = 3;
+		break;
+	case HALT:
+	case FENCE:
+	case RET:
+	case LEAVE:
+		I.OP = OP_CODE(OP);
+		I.LEN = 1;
+		break;
+	default:
+		I.OP = OP_INVALID;
+		I.IMM = OP;
+		I.LEN = 1;
+		break;
+	}
+}
+
+// ػָ: OPĲֽ, ȺѰַʽжڱ
+// Ϊ0ʱıκ״̬, EXIT_FAULTͣ
+template<BYTE OP> inline bool CPU::Arith(const INST *I){
+	if (OP & MR_BYTE){
+		ALU.RA = RegB(I->RA);
+		ALU.RB = RegB(I->RB);
+		if ((OP_CODE(OP) == DIV || OP_CODE(OP) == MOD) && ALU.RB == 0) return fault();
+		ALU.execute<OP_CODE(OP)>();
+		RegB(I->RC, ALU.R);
+	}else{
+		ALU.RA = REG[I->RA];
+		ALU.RB = REG[I->RB];
+		if ((OP_CODE(OP) == DIV || OP_CODE(OP) == MOD) && ALU.RB == 0) return fault();
+		ALU.execute<OP_CODE(OP)>();
+		REG[I->RC] = ALU.R;
+	}
+	return true;
+}
+template<BYTE OP> inline void CPU::Neg(const INST *I){
+	if (OP & MR_BYTE){
+		ALU.RA = RegB(I->RA);
+		ALU.execute<NEG>();
+		RegB(I->RB, ALU.R);
+	}else{
+		ALU.RA = REG[I->RA];
+		ALU.execute<NEG>();
+		REG[I->RB] = ALU.R;
+	}
+}
+template<BYTE OP> inline void CPU::Push(const INST *I){
+	if (OP & MR_BYTE){
+		RAM[SP--] = RegB(I->RA);
+	}else{
+		RAM[SP--] = REG[I->RA] >> 8;
+		RAM[SP--] = REG[I->RA];
+	}
+}
+template<BYTE OP> inline void CPU::Pop(const INST *I){
+	if (OP & MR_BYTE){
+		RegB(I->RA, RAM[SP++]);
+	}else{
+		REG[I->RA] = RAM[SP++];
+		REG[I->RA] |= RAM[SP++] << 8;
+	}
+}
+template<BYTE OP> inline void CPU::Load(const INST *I){
+	if (OP & MR_BYTE){
+		RegB(I->RA, (OP & MR_B) ? RAM[I->IMM] : I->IMM);
+	}else{
+		REG[I->RA] = (OP & MR_B) ? ReadW(I->IMM) : I->IMM;
+	}
+}
+template<BYTE OP> inline void CPU::Store(const INST *I){
+	if (!(OP & MR_B)){
+		printf("error storew");
+	}
+	if (OP & MR_BYTE){
+		RAM[I->IMM] = RegB(I->RA);
+	}else{
+		WriteW(I->IMM, REG[I->RA]);
+	}
+	invalidate(I->IMM);
+}
+// IN/OUT: ˿ڽ豸ʱ豸, д˿PORT[]
+// 鴫(MR_B)RAM[REG[RA]]REG[RB]ֽ, ƻصַ0, ʵʴ͵ֽдREG[RB]
+// 豸ûʱINȫ1; 豸DEVICE_WAITʱݴİⲻıκ״̬false, execute
+// ֶֻһֽʱݴHALFȵڶֽ, ݲ; ֮ö˿ڵֽڶͿȡݴֽ
+template<BYTE OP> inline bool CPU::In(const INST *I){
+	Device *D = DEVICE[I->IMM];
+	bool PENDING = HALF >= 0 && (HALF >> 8) == I->IMM;
+	if (OP & MR_B){
+		WORD ADDR = REG[I->RA];
+		size_t SIZE = 0x10000 - ADDR;
+		if (REG[I->RB] < SIZE) SIZE = REG[I->RB];
+		if (PENDING && SIZE){
+			// һֽڿɽ, 豸ûиʱ
+			RAM[ADDR] = (BYTE)HALF;
+			HALF = -1;
+			size_t N = D ? D->read(RAM + ADDR + 1, SIZE - 1) : 0;
+			SIZE = N == DEVICE_WAIT ? 1 : N + 1;
+		}else{
+			SIZE = D ? D->read(RAM + ADDR, SIZE) : 0;
+			if (SIZE == DEVICE_WAIT) return block(D);
+		}
+		REG[I->RB] = (WORD)SIZE;
+		invalidate(ADDR, SIZE);
+	}else if (OP & MR_BYTE){
+		if (PENDING){
+			RegB(I->RA, (BYTE)HALF);
+			HALF = -1;
+			return true;
+		}
+		BYTE B = (BYTE)PORT[I->IMM];
+		size_t N = D ? D->read(&B, 1) : 1;
+		if (N == DEVICE_WAIT) return block(D);
+		RegB(I->RA, N == 1 ? B : 0xFF);
+	}else if (D){
+		BYTE B[2];
+		size_t K = 0;
+		if (PENDING) B[K++] = (BYTE)HALF;
+		while (K < 2){
+			size_t N = D->read(B + K, 2 - K);
+			if (N == DEVICE_WAIT){
+				if (K) HALF = I->IMM << 8 | B[0];
+				return block(D);
 			}
-			break;
-		case IN:
-			break;
-		case OUT:
-			break;
-		case HALT:
-			break;
-		default:
-			printf("invalid OP=%d at IP=%04x\n", OP, IP);
+			if (N == 0) break;
+			K += N;
+		}
+		if (PENDING) HALF = -1;
+		// ļβʱȱֽڶȫ1
+		REG[I->RA] = K == 2 ? B[0] | B[1] << 8 : K == 1 ? B[0] | 0xFF00 : 0xFFFF;
+	}else{
+		REG[I->RA] = PORT[I->IMM];
+	}
+	return true;
+}
+template<BYTE OP> inline bool CPU::Out(const INST *I){
+	Device *D = DEVICE[I->IMM];
+	if (OP & MR_B){
+		WORD ADDR = REG[I->RA];
+		size_t SIZE = 0x10000 - ADDR;
+		if (REG[I->RB] < SIZE) SIZE = REG[I->RB];
+		SIZE = D ? D->write(RAM + ADDR, SIZE) : 0;
+		if (SIZE == DEVICE_WAIT) return block(D);
+		REG[I->RB] = (WORD)SIZE;
+	}else if (OP & MR_BYTE){
+		BYTE B = RegB(I->RA);
+		if (!D){
+			PORT[I->IMM] = B;
+		}else if (D->write(&B, 1) == DEVICE_WAIT){
+			return block(D);
+		}
+	}else if (D){
+		BYTE B[2] = { (BYTE)REG[I->RA], (BYTE)(REG[I->RA] >> 8) };
+		if (D->write(B, 2) == DEVICE_WAIT) return block(D);
+	}else{
+		PORT[I->IMM] = REG[I->RA];
+	}
+	return true;
+}
+
+// RAMֽͨ, ܵatomic<>, ԭӲñڽ; ԭֵ
+// ֵĵַɵֶ֤߱(RAMҳ)
+#ifdef _MSC_VER
+inline BYTE ram_cas(BYTE *P, BYTE E, BYTE N){
+	return (BYTE)_InterlockedCompareExchange8((char*)P, (char)N, (char)E);
+}
+inline WORD ram_cas(WORD *P, WORD E, WORD N){
+	return (WORD)_InterlockedCompareExchange16((short*)P, (short)N, (short)E);
+}
+inline BYTE ram_add(BYTE *P, BYTE V){
+	return (BYTE)_InterlockedExchangeAdd8((char*)P, (char)V);
+}
+inline WORD ram_add(WORD *P, WORD V){
+	return (WORD)_InterlockedExchangeAdd16((short*)P, (short)V);
+}
+#else
+template<class T> inline T ram_cas(T *P, T E, T N){
+	__atomic_compare_exchange_n(P, &E, N, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+	return E;
+}
+template<class T> inline T ram_add(T *P, T V){
+	return __atomic_fetch_add(P, V, __ATOMIC_SEQ_CST);
+}
+#endif
+
+// ԭָ, ˹RAMʱʹ, ˳һµ
+// cas $a $e $n: [REG[a]] == REG[e]дREG[n]; REG[e]õԭֵ, ɹʱJE
+// xadd $a $v: [REG[a]] += REG[v], REG[v]õԭֵ
+// ֲĵַ밴ֶ, EXIT_FAULTͣ
+// ϵͨLOAD/STOREԭӵ: CAS/XADDͬһַʱֵȷ, ֮ͨдֻFENCE,
+// ҪôֻCAS/XADD, ҪôFENCE֮д
+template<BYTE OP> inline bool CPU::Cas(const INST *I){
+	WORD ADDR = REG[I->RA];
+	if (OP & MR_BYTE){
+		BYTE E = ram_cas(RAM + ADDR, RegB(I->RB), RegB(I->RC));
+		ALU.RA = E;
+		ALU.RB = RegB(I->RB);
+		RegB(I->RB, E);
+	}else{
+		if (ADDR & 1) return fault();
+		WORD E = ram_cas((WORD*)(RAM + ADDR), REG[I->RB], REG[I->RC]);
+		ALU.RA = E;
+		ALU.RB = REG[I->RB];
+		REG[I->RB] = E;
+	}
+	ALU.execute<CMP>();
+	invalidate(ADDR);
+	return true;
+}
+template<BYTE OP> inline bool CPU::Xadd(const INST *I){
+	WORD ADDR = REG[I->RA];
+	if (OP & MR_BYTE){
+		RegB(I->RB, ram_add(RAM + ADDR, RegB(I->RB)));
+	}else{
+		if (ADDR & 1) return fault();
+		REG[I->RB] = ram_add((WORD*)(RAM + ADDR), REG[I->RB]);
+	}
+	invalidate(ADDR);
+	return true;
+}
+
+// Զڴ: loadf $a $s $o[REG[s]:REG[o]]REG[a], storef $a $s $oREG[a]д
+// ֲڶڰֻ, Կҳ; δҳõ0Ҳ, дʱҳ, ޶ʱEXIT_FAULTͣ
+template<BYTE OP> inline void CPU::LoadF(const INST *I){
+	WORD SEG = REG[I->RB], OFF = REG[I->RC];
+	BYTE *P = xlat(SEG, OFF, false);
+	if (OP & MR_BYTE){
+		RegB(I->RA, P ? *P : 0);
+	}else if ((OFF & (FAR_PAGE - 1)) != FAR_PAGE - 1){
+		REG[I->RA] = P ? P[0] | P[1] << 8 : 0;
+	}else{
+		BYTE *Q = xlat(SEG, (WORD)(OFF + 1), false);
+		REG[I->RA] = (P ? P[0] : 0) | (Q ? Q[0] : 0) << 8;
+	}
+}
+template<BYTE OP> inline bool CPU::StoreF(const INST *I){
+	WORD SEG = REG[I->RB], OFF = REG[I->RC];
+	BYTE *P = xlat(SEG, OFF, true);
+	if (!P) return fault();
+	if (OP & MR_BYTE){
+		*P = RegB(I->RA);
+	}else if ((OFF & (FAR_PAGE - 1)) != FAR_PAGE - 1){
+		P[0] = (BYTE)REG[I->RA];
+		P[1] = REG[I->RA] >> 8;
+	}else{
+		BYTE *Q = xlat(SEG, (WORD)(OFF + 1), true);
+		if (!Q) return fault();
+		*P = (BYTE)REG[I->RA];
+		*Q = REG[I->RA] >> 8;
+	}
+	if (SEG == 0) invalidate(OFF);
+	return true;
+}
+
+// , REPǰ׺ķʽִ: ֽڲֽΪλ, ֲΪλ
+// movs $d $s $n: [REG[s]]REG[n]λƵ[REG[d]], memmoveص
+// stos $d $v $n: REG[v](ֽڲȡֽ)䵽[REG[d]]REG[n]λ
+// cmps $a $b $n: Ƚ[REG[a]][REG[b]]REG[n]λ, ڵһͬͣ, ־Ƚλ, ȫͬʱJE
+// ַĴָĲ֮(cmpsָͬĵλ), REG[n]Ϊʣĵλ, movs/stosΪ0
+// ִǰһ, ƻصַ0, RAMʱıκ״̬, EXIT_FAULTͣ
+#define BLOCK_UNIT(OP)	((OP) & MR_BYTE ? 1 : 2)
+#define BLOCK_FITS(ADDR, SIZE)	((size_t)(ADDR) + (SIZE) <= 0x10000)
+template<BYTE OP> inline bool CPU::Movs(const INST *I){
+	WORD D = REG[I->RA], S = REG[I->RB];
+	size_t SIZE = (size_t)REG[I->RC] * BLOCK_UNIT(OP);
+	if (!BLOCK_FITS(D, SIZE) || !BLOCK_FITS(S, SIZE)) return fault();
+	memmove(RAM + D, RAM + S, SIZE);
+	REG[I->RA] = (WORD)(D + SIZE);
+	REG[I->RB] = (WORD)(S + SIZE);
+	REG[I->RC] = 0;
+	invalidate(D, SIZE);
+	return true;
+}
+template<BYTE OP> inline bool CPU::Stos(const INST *I){
+	WORD D = REG[I->RA];
+	size_t SIZE = (size_t)REG[I->RC] * BLOCK_UNIT(OP);
+	if (!BLOCK_FITS(D, SIZE)) return fault();
+	BYTE *P = RAM + D;
+	if ((OP & MR_BYTE) || (BYTE)REG[I->RB] == REG[I->RB] >> 8){
+		memset(P, (BYTE)REG[I->RB], SIZE);
+	}else if (SIZE){
+		// дһ, ٰ, ʱҲֻO(log n)memcpy
+		P[0] = (BYTE)REG[I->RB];
+		P[1] = REG[I->RB] >> 8;
+		for (size_t K = 2; K < SIZE; K *= 2){
+			memcpy(P + K, P, K < SIZE - K ? K : SIZE - K);
+		}
+	}
+	REG[I->RA] = (WORD)(D + SIZE);
+	REG[I->RC] = 0;
+	invalidate(D, SIZE);
+	return true;
+}
+template<BYTE OP> inline bool CPU::Cmps(const INST *I){
+	const size_t UNIT = BLOCK_UNIT(OP), CHUNK = 256;
+	WORD A = REG[I->RA], B = REG[I->RB];
+	size_t SIZE = (size_t)REG[I->RC] * UNIT;
+	if (!BLOCK_FITS(A, SIZE) || !BLOCK_FITS(B, SIZE)) return fault();
+	// memcmpͬĲ, ֻڲͬĿֽҵһͬ
+	size_t K = 0;
+	while (K < SIZE){
+		size_t N = SIZE - K < CHUNK ? SIZE - K : CHUNK;
+		if (memcmp(RAM + A + K, RAM + B + K, N) != 0){
+			while (RAM[A + K] == RAM[B + K]) K++;
 			break;
 		}
-		trace();
-	}while (IP < LENGTH && OP != HALT);
+		K += N;
+	}
+	K -= K % UNIT;
+	if (K < SIZE){
+		ALU.RA = UNIT == 1 ? RAM[A + K] : RAM[A + K] | RAM[A + K + 1] << 8;
+		ALU.RB = UNIT == 1 ? RAM[B + K] : RAM[B + K] | RAM[B + K + 1] << 8;
+	}else{
+		ALU.RA = ALU.RB = 0;
+	}
+	ALU.execute<CMP>();
+	REG[I->RA] = (WORD)(A + K);
+	REG[I->RB] = (WORD)(B + K);
+	REG[I->RC] = (WORD)((SIZE - K) / UNIT);
+	return true;
+}
+
+// ִBUDGET, ͣµԭ; EXIT_HALT/EXIT_FAULTⶼٴεüִ
+BYTE CPU::execute(UINT BUDGET){
+	LIMIT = BUDGET > ~CYCLE ? ~0u : CYCLE + BUDGET;
+	if (!VERIFIED) return run<true>();
+	UINT END = LIMIT;
+	run<false>();
+	// УĴ뱻дʱinvalidateУ鲢LIMITǰǰ, ʣԤ㰴ķʽִ
+	if (EXIT == EXIT_BUDGET && !VERIFIED && CYCLE < END){
+		LIMIT = END;
+		run<true>();
+	}
+	return EXIT;
 }
-void CPU::trace(){
+// ִеLIMITΪֹ; CHECKEDΪfalseʱʡУѾ֤ļ
+template<bool CHECKED> BYTE CPU::run(){
+	WORD PC = IP;
+	WORD ABUS, DBUS;
+	INST *I, *CODE = ICACHE.data();
+#ifdef VM_THREADED_DISPATCH
+	// ֽ(Ѱַʽ/ֽλ)ֱ
+	void *TABLE[0x100];
+	for (int i = 0; i < 0x100; i++){
+		TABLE[i] = &&L_INVALID;
+	}
+	BIND2(ADD); BIND2(SUB); BIND2(MUL); BIND2(DIV); BIND2(MOD); BIND2(CMP);
+	BIND2(NEG);
+	BIND(JB); BIND(JG); BIND(JE); BIND(JNE); BIND(JMP);
+	BIND2(PUSH); BIND2(POP);
+	BIND4(LOAD); BIND4(STORE);
+	BIND4(IN); BIND4(OUT);
+	BIND2(CAS); BIND2(XADD); BIND(FENCE);
+	BIND2(LOADF); BIND2(STOREF);
+	BIND2(MOVS); BIND2(STOS); BIND2(CMPS);
+	BIND(CALL); BIND(RET); BIND(ENTER); BIND(LEAVE);
+	BIND(HALT);
+	BIND(F_LLAS); BIND(F_LLA); BIND(F_LS); BIND(F_AJ);
+	BIND(OP_END);
+#endif
+	DISPATCH_BEGIN
+	SPECIAL2(ADD, Arith)
+	SPECIAL2(SUB, Arith)
+	SPECIAL2(MUL, Arith)
+	STOPPABLE2(DIV, Arith)
+	STOPPABLE2(MOD, Arith)
+	SPECIAL2(CMP, Arith)
+	SPECIAL2(NEG, Neg)
+	OPCASE(JB)
+		if (ALU.lt()){
+			PC = I->IMM;
+		}
+		JIT_ENTER();
+		NEXT();
+	OPCASE(JG)
+		if (ALU.gt()){
+			PC = I->IMM;
+		}
+		JIT_ENTER();
+		NEXT();
+	OPCASE(JE)
+		if (!ALU.gt() && !ALU.lt()){
+			PC = I->IMM;
+		}
+		JIT_ENTER();
+		NEXT();
+	OPCASE(JNE)
+		if (ALU.gt() || ALU.lt()){
+			PC = I->IMM;
+		}
+		JIT_ENTER();
+		NEXT();
+	OPCASE(JMP)
+		PC = I->IMM;
+		JIT_ENTER();
+		NEXT();
+	// call f: һָĵַѹķصַջתf, ret: , дͻջ
+	// ;ֲڿͻջ, enter/leaveͳ$bpΪַջ֡
+	// صַջʱEXIT_FAULTͣ, IPͣCALL/RET
+	OPCASE(CALL)
+		if (RSP == RSTACK_SIZE){
+			CYCLE--;
+			IP = PC - I->LEN;
+			EXIT = EXIT_FAULT;
+			return EXIT;
+		}
+		RSTACK[RSP++] = PC;
+		PC = I->IMM;
+		JIT_ENTER();
+		NEXT();
+	OPCASE(RET)
+		if (RSP == 0){
+			CYCLE--;
+			IP = PC - I->LEN;
+			EXIT = EXIT_FAULT;
+			return EXIT;
+		}
+		PC = RSTACK[--RSP];
+		JIT_ENTER();
+		NEXT();
+	// ENTERPUSHһ, УĴֲ֤ͬڵջᵽ, еݹʱ(GUARD)
+	OPCASE(ENTER)
+		RAM[SP--] = REG[Reg::BP] >> 8;
+		RAM[SP--] = (BYTE)REG[Reg::BP];
+		if (CHECKED || GUARD) invalidate((WORD)(SP + 1));
+		REG[Reg::BP] = SP;
+		SP -= I->IMM;
+		NEXT();
+	OPCASE(LEAVE)
+		SP = REG[Reg::BP];
+		REG[Reg::BP] = RAM[(WORD)(SP + 1)] | RAM[(WORD)(SP + 2)] << 8;
+		SP += 2;
+		NEXT();
+	// ջصʱѹջд, УĴ֤ջᵽ, еݹʱ(GUARD)
+	OPCASEM(PUSH, W)
+		Push<PUSH | MODE_W>(I);
+		if (CHECKED || GUARD) invalidate((WORD)(SP + 1));
+		NEXT();
+	OPCASEM(PUSH, B)
+		Push<PUSH | MODE_B>(I);
+		if (CHECKED || GUARD) invalidate((WORD)(SP + 1));
+		NEXT();
+	SPECIAL2(POP, Pop)
+	SPECIAL4(LOAD, Load)
+	SPECIAL4(STORE, Store)
+	STOPPABLE4(IN, In)
+	STOPPABLE4(OUT, Out)
+	STOPPABLE2(CAS, Cas)
+	STOPPABLE2(XADD, Xadd)
+	OPCASE(FENCE)
+		atomic_thread_fence(memory_order_seq_cst);
+		NEXT();
+	SPECIAL2(LOADF, LoadF)
+	STOPPABLE2(STOREF, StoreF)
+	STOPPABLE2(MOVS, Movs)
+	STOPPABLE2(STOS, Stos)
+	STOPPABLE2(CMPS, Cmps)
+	OPCASE(HALT)
+		TRACE();
+		IP = PC;
+		EXIT = EXIT_HALT;
+		return EXIT;
+	OPCASE(F_LLAS)
+		FUSED(3);
+		DBUS = ReadW(I->IMM);
+		REG[I->RA] = DBUS;
+		REG[I->RB] = I->IMM2;
+		ALU.OP = I->AOP;
+		ALU.RA = REG[I->RA];
+		ALU.RB = REG[I->RB];
+		ALU.execute();
+		REG[I->RC] = ALU.R;
+		ABUS = I->IMM3;
+		WriteW(ABUS, REG[I->RC]);
+		invalidate(ABUS);
+		NEXT();
+	OPCASE(F_LLA)
+		FUSED(2);
+		DBUS = ReadW(I->IMM);
+		REG[I->RA] = DBUS;
+		REG[I->RB] = I->IMM2;
+		ALU.OP = I->AOP;
+		ALU.RA = REG[I->RA];
+		ALU.RB = REG[I->RB];
+		ALU.execute();
+		REG[I->RC] = ALU.R;
+		NEXT();
+	OPCASE(F_LS)
+		FUSED(1);
+		DBUS = ReadW(I->IMM);
+		REG[I->RA] = DBUS;
+		ABUS = I->IMM2;
+		WriteW(ABUS, REG[I->RA]);
+		invalidate(ABUS);
+		NEXT();
+	OPCASE(F_AJ)
+		FUSED(1);
+		ALU.OP = I->AOP;
+		ALU.RA = REG[I->RA];
+		ALU.RB = REG[I->RB];
+		ALU.execute();
+		REG[I->RC] = ALU.R;
+		switch (I->JOP){
+		case JB:if (ALU.lt()) PC = I->IMM; break;
+		case JG:if (ALU.gt()) PC = I->IMM; break;
+		case JE:if (!ALU.gt() && !ALU.lt()) PC = I->IMM; break;
+		case JNE:if (ALU.gt() || ALU.lt()) PC = I->IMM; break;
+		}
+		JIT_ENTER();
+		NEXT();
+	OPCASE(OP_END)
+		CYCLE--;
+		IP = LENGTH;
+		EXIT = EXIT_END;
+		return EXIT;
+	OPDEFAULT
+		CYCLE--;
+		IP = PC - I->LEN;
+		EXIT = EXIT_FAULT;
+		return EXIT;
+	DISPATCH_END
+	IP = PC;
+	EXIT = PC >= LENGTH ? EXIT_END : EXIT_BUDGET;
+	return EXIT;
+}
+// ִֻгָIĵһָ(load $a &xop $a $b $c), PCΪI֮ĵַ, صһָ֮ĵַ
+WORD CPU::lead(const INST *I, WORD PC){
+	WORD ADDR = PC - I->LEN;
+	INST L;
+	decode(ADDR, L);
+	if (I->OP == F_AJ){
+		ALU.OP = I->AOP;
+		ALU.RA = REG[I->RA];
+		ALU.RB = REG[I->RB];
+		ALU.execute();
+		REG[I->RC] = ALU.R;
+	}else{
+		REG[I->RA] = ReadW(I->IMM);
+	}
+	return ADDR + L.LEN;
+}
+// ÿִָк, IǸִеָ, IPָһָ
+void CPU::trace(const INST *I){
+#ifdef VM_TRACE
+	if (TRACER){
+		TRACE_REC R;
+		R.CYCLE = CYCLE;
+		R.IP = (WORD)(I - ICACHE.data());
+		R.OP = I->OP;
+		R.RA = I->RA;
+		R.RB = I->RB;
+		R.RC = I->RC;
+		R.IMM = I->IMM;
+		R.FR = ALU.flags();
+		R.NEXT = IP;
+		TRACER->push(R);
+	}
+#else
+	(void)I;
+#endif
 #ifdef _DEBUG
 	char c;
 	cin >> c;
-	printf("[CYCLE:%04d DS:%04d CS:%04d IP:%04x]", CYCLE, DS, CS, IP);
+	printf("[CYCLE:%04u DS:%04d CS:%04d IP:%04x]", CYCLE, DS, CS, IP);
 	printf("[%4d", RAM[DS]);
 	for (int i = DS + 1; i < CS; i++){
 		printf(" %4d", RAM[i]);
 	}
 	printf("]\n");
 #endif
-}
\ No newline at end of file
+}
+#ifdef VM_TRACE
+// ٲSIZE¼, SIZEΪ0ʱر
+void CPU::tracing(size_t SIZE){
+	delete TRACER;
+	TRACER = SIZE ? new TraceRing(SIZE) : nullptr;
+}
+// Ѹٻдfp, trace_decode߽
+void CPU::dump(FILE *fp){
+	if (TRACER) TRACER->dump(fp);
+}
+#endif
\ No newline at end of file
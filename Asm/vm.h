@@ -5,7 +5,15 @@
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <vector>
+#include <map>
+#include <memory>
+#include <atomic>
 #include "code.h"
+#include "trace.h"
+#include "image.h"
+#include "device.h"
+#include "paging.h"
 
 using namespace std;
 
@@ -25,23 +33,35 @@ using namespace std;
 //#define MR_F		0x04// offsetѰַ
 //#define MR_G		0x02// [BP]ַѰַ
 //#define MR_H		0x01// [reg+addr]ַѰַ
+#define MR_A		0x00// 0000
+#define MR_B		0x40// 0100ֱѰַ
 
 // /ֽڲ
 #define MR_BYTE		0x80
+// ȥѰַʽ/ֽλĲ
+#define OP_CODE(op)	((op) & ~(MR_BYTE | MR_B))
 // [111][111][0][0]
 #define REG_SRC_MASK	0xE0
 #define REG_DST_MASK	0x1C
 
+// ָɷʽ: GCC/ClangĬcomputed gotoֱ,
+// VM_SWITCH_DISPATCH(ʹMSVC)ʱ˻صֲswitch
+#if defined(__GNUC__) && !defined(VM_SWITCH_DISPATCH)
+#define VM_THREADED_DISPATCH
+#endif
+
+// ־λֵ: executeֻ, һĲͽ,
+// תֻȽϲ, ҪFRʱ(/ش)flags()
 class ALU{
 public:
 	BYTE OP;
 	WORD RA, RB;
 	WORD R;
-	WORD FR;
 	ALU(){
 		OP = 0;
 		RA = RB = R = 0;
 		FR = 0;
+		LAZY = false;
 	}
 	void execute(){
 		switch (OP){
@@ -54,29 +74,165 @@ public:
 		case NEG:R = 0 - RA; break;
 		default:FR |= BIT_ERR; break;
 		}
-		FR &= ~BIT_ZERO;
-		FR &= ~BIT_GT;
-		FR &= ~BIT_LT;
-		FR &= ~BIT_NEG;
-		FR |= (R == 0) ? BIT_ZERO : BIT_MASK;
-		FR |= (R < 0) ? BIT_NEG : BIT_MASK;
-		FR |= (RA > RB) ? BIT_GT : BIT_MASK;
-		FR |= (RA < RB) ? BIT_LT : BIT_MASK;
+		LAZY = true;
+	}
+	// ڱȷ, ػָʹ
+	template<BYTE CODE> void execute(){
+		OP = CODE;
+		switch (CODE){
+		case ADD:R = RA + RB; break;
+		case SUB:R = RA - RB; break;
+		case MUL:R = RA * RB; break;
+		case DIV:R = RA / RB; break;
+		case MOD:R = RA % RB; break;
+		case CMP:R = RA == RB; break;
+		case NEG:R = 0 - RA; break;
+		default:FR |= BIT_ERR; break;
+		}
+		LAZY = true;
+	}
+	// תõı־, FR
+	bool gt(){
+		return LAZY ? RA > RB : (FR & BIT_GT) != 0;
+	}
+	bool lt(){
+		return LAZY ? RA < RB : (FR & BIT_LT) != 0;
+	}
+	// ־Ĵ
+	WORD flags(){
+		if (LAZY){
+			FR &= ~BIT_ZERO;
+			FR &= ~BIT_GT;
+			FR &= ~BIT_LT;
+			FR &= ~BIT_NEG;
+			FR |= (R == 0) ? BIT_ZERO : BIT_MASK;
+			FR |= (R < 0) ? BIT_NEG : BIT_MASK;
+			FR |= (RA > RB) ? BIT_GT : BIT_MASK;
+			FR |= (RA < RB) ? BIT_LT : BIT_MASK;
+			LAZY = false;
+		}
+		return FR;
+	}
+	void flags(WORD F){
+		FR = F;
+		LAZY = false;
 	}
+private:
+	WORD FR;
+	bool LAZY;				// FRеZERO/NEG/GT/LTδһ
+};
+
+// Ԥָ: װʱIPһ, ֱִ֮
+struct INST{
+	BYTE OP;		// ֽ(Ѱַʽ/ֽλ)
+	BYTE LEN;		// ָ
+	BYTE RA, RB, RC;// Ĵ
+	BYTE AOP, JOP;	// ָе/ת
+	WORD IMM;		// /ַ/תĿ
+	WORD IMM2, IMM3;// ָ/ַ
+};
+
+// ָ: װʱɳָں϶, ֻԤָ
+enum Fused{
+	F_LLAS = 0x30,	// load $a &x; load $b imm; op $a $b $c; store $c &y
+	F_LLA,			// load $a &x; load $b imm; op $a $b $c
+	F_LS,			// load $a &x; store $a &y
+	F_AJ,			// op $a $b $c; jcc L
+	OP_END = 0x3E,	// ĩβڱ, ֻICACHE[LENGTH]
+	OP_INVALID = 0x3F// Ƿָ
+};
+
+// ָ, ɰλ
+#define FUSE_LLAS	0x01
+#define FUSE_LLA	0x02
+#define FUSE_LS		0x04
+#define FUSE_AJ		0x08
+#define FUSE_ALL	0x0F
+
+// ִʱIN˿ڶ˵ı
+#define PORT_CORE	0xFF
+
+// ָֽ
+#define INST_MAX_LEN	4
+// ָาǵֽ
+#define FUSE_MAX_LEN	(4 * INST_MAX_LEN)
+
+// ͳģʽÿִжָһεջ
+#define PROFILE_PERIOD	64
+// Ӱӵջ
+#define PROFILE_DEPTH	256
+
+// executeصԭ
+enum Exit{
+	EXIT_NONE,		// δִ
+	EXIT_HALT,		// ִHALT
+	EXIT_END,		// ִеĩβ
+	EXIT_WAIT,		// IN/OUT豸δ, IPͣڸָ, ٴexecute
+	EXIT_BUDGET,	// ˱executeԤ
+	EXIT_FAULT		// ǷָΪ0, IPͣڸָ
 };
 
+// execute
+#define BUDGET_ALL		0xFFFFFFFF
+
+class JIT;
+struct ACTX;
+class Batch;
+class SMP;
+
 class CPU{
+	friend class JIT;
+	friend class Batch;
+	friend class SMP;
 private:
 	WORD LENGTH = 0;
-	BYTE REG[0x100];
+	alignas(64) WORD REG[0x100];// Ĵļ, ÿĴһ, ж
 	WORD SP, BP, SI, DI;		// ͨüĴ
 	WORD CS, DS, ES, SS;		// μĴ
-	WORD PORT[0x100];			// I/O˿
+	WORD PORT[0x100];			// I/O˿, δ豸Ķ˿Ϊ
+	Device *DEVICE[0x100] = {};	// ˿ϵ豸, ɵ
+	Device *WAIT = nullptr;		// EXIT_WAITʱȴ豸
+	int HALF = -1;				// ֶֻһֽʱݴ(˿ << 8 | ֽ), ûʱΪ-1
 	WORD IP;					// ָ
+	WORD RSTACK[RSTACK_SIZE];	// صַջ, CALLѹһָĵַ, RET
+	WORD RSP = 0;				// صַջ
 	WORD IBUS, DBUS, ABUS;		// ڲ
-	BYTE RAM[0x10000];			// ڴ
-	WORD CYCLE = 0;				// ִ
+	BYTE *RAM;					// ڴ, 64K, װֽӳʱӳ䵽ļ
+	bool OWN = true;			// RAM鱾ʵ; ʱ˹˵RAM
+	UINT CYCLE = 0;				// ִ
+	UINT LIMIT = 0;				// executeִеĸΪֹ
+	BYTE EXIT = EXIT_NONE;		// executeصԭ
 	ALU ALU;					// ALU
+	vector<INST> ICACHE;		// Ԥָ, IP, ĩβһڱ
+	bool VERIFIED = false;		// ͨУ, ִʱʡԽ
+	bool GUARD = false;			// Уеݹ, ջ޽, ѹջԼǷд
+	UINT FUSE = FUSE_ALL;		// õĳָ
+	JIT *NATIVE = nullptr;		// ش뻺, δJITʱΪ
+	void *MODULE = nullptr;		// װAOTģ
+	WORD(*AOTFN)(ACTX *ctx, WORD PC) = nullptr;	// ģ, 뱻дÿ
+	string AOTPATH;
+	shared_ptr<RAM_SHARE> SHARE;	// forkʱڴ, ʵ
+	shared_ptr<Paging> PAGING;	// Զڴҳ, ״дԶڴʱ; ʱ˹
+	TLB_ENTRY TLB[TLB_SIZE];	// ԶڴTLB
+#ifdef VM_PROFILE
+	UINT SEQ = 0;				// ǰִеĲ
+	BYTE SEQLEN = 0;
+	map<unsigned long long, UINT> NGRAM;	// еִд
+	UINT OPS[0x100] = {};		// ÿֽڵִд
+	vector<UINT> HITS;			// ÿIPִд
+	vector<UINT> TAKEN, FALLS;	// ÿת/Ĵ
+	int BRANCH = -1;			// һָתʱΪIP
+	vector<WORD> FRAMES;		// Ӱӵջ, push/pop $bpά
+	map<vector<WORD>, UINT> STACKS;	// ջ, һΪʱIP
+	UINT TICK = 0;
+	void profile(const INST *I);
+	void ngram(const INST *I);
+	void frame(WORD ID);
+	void unframe();
+#endif
+#ifdef VM_TRACE
+	TraceRing *TRACER = nullptr;		// ٻ, δʱΪ
+#endif
 	BYTE ReadB(){
 		return RAM[IP++];
 	}
@@ -94,19 +250,156 @@ private:
 		WORD W;
 		W ^= W;
 		W |= (WORD)RAM[ADDR];
-		W |= (WORD)RAM[ADDR + 1] << 8;// ֽ
+		W |= (WORD)RAM[(WORD)(ADDR + 1)] << 8;// ֽ, 0xFFFFƻ0
 		return W;
 	}
 	void WriteW(WORD ADDR, WORD DATA){
 		RAM[ADDR] = DATA;
-		RAM[ADDR + 1] = DATA >> 8;// ֽ
+		RAM[(WORD)(ADDR + 1)] = DATA >> 8;// ֽ
+	}
+	// ֽڲ(MR_BYTE)ֻдĴĵֽ
+	BYTE RegB(BYTE R){
+		return (BYTE)REG[R];
+	}
+	void RegB(BYTE R, BYTE DATA){
+		REG[R] = (REG[R] & 0xFF00) | DATA;
+	}
+	void decode(WORD ADDR, INST &I);
+	void decode(WORD ADDR){
+		decode(ADDR, ICACHE[ADDR]);
+		fuse(ADDR);
+	}
+	void fuse(WORD ADDR);
+	WORD lead(const INST *I, WORD PC);
+	template<BYTE OP> bool Arith(const INST *I);
+	template<BYTE OP> void Neg(const INST *I);
+	template<BYTE OP> void Push(const INST *I);
+	template<BYTE OP> void Pop(const INST *I);
+	template<BYTE OP> void Load(const INST *I);
+	template<BYTE OP> void Store(const INST *I);
+	template<BYTE OP> bool In(const INST *I);
+	template<BYTE OP> bool Out(const INST *I);
+	template<BYTE OP> bool Cas(const INST *I);
+	template<BYTE OP> bool Xadd(const INST *I);
+	template<BYTE OP> void LoadF(const INST *I);
+	template<BYTE OP> bool StoreF(const INST *I);
+	template<BYTE OP> bool Movs(const INST *I);
+	template<BYTE OP> bool Stos(const INST *I);
+	template<BYTE OP> bool Cmps(const INST *I);
+	// ԶڴַSEG:OFFеλ, TLBʱҳ; ҳδҲҪʱؿ
+	BYTE *xlat(WORD SEG, WORD OFF, bool ALLOC){
+		UINT N = FAR_PN(SEG, OFF);
+		TLB_ENTRY &E = TLB[N % TLB_SIZE];
+		if (E.TAG != N && !walk(N, ALLOC)) return nullptr;
+		return E.PAGE + (OFF & (FAR_PAGE - 1));
+	}
+	bool walk(UINT N, bool ALLOC);
+	void flush();
+	bool block(Device *D){
+		WAIT = D;
+		EXIT = EXIT_WAIT;
+		return false;
+	}
+	bool fault(){
+		EXIT = EXIT_FAULT;
+		return false;
+	}
+	// дʱ븲ǵADDR..ADDR+1ָ, дĴ벻У
+	void invalidate(WORD ADDR){
+		if (ADDR + 1 < CS || ADDR >= LENGTH) return;
+		if (VERIFIED){
+			VERIFIED = false;
+			LIMIT = CYCLE;
+		}
+		for (int A = ADDR - (FUSE_MAX_LEN - 1); A <= ADDR + 1; A++){
+			if (A >= CS && A < LENGTH){
+				decode(A);
+			}
+		}
+		if (NATIVE) discard(ADDR);
+		AOTFN = nullptr;
+	}
+	// дֻصĲ
+	void invalidate(WORD ADDR, size_t SIZE){
+		size_t A = ADDR, END = ADDR + SIZE;
+		if (A + 1 < CS) A = CS ? CS - 1 : 0;
+		if (END > LENGTH) END = LENGTH;
+		for (; A < END; A += 2){
+			invalidate((WORD)A);
+		}
 	}
+	template<bool CHECKED> BYTE run();
+	WORD enter(WORD PC);
+	WORD invoke(WORD PC);
+	void discard(WORD ADDR);
+	void prepare();
 public:
+	CPU(){
+		RAM = ram_alloc();
+		flush();
+	}
+	CPU(const CPU&) = delete;
+	CPU &operator=(const CPU&) = delete;
+	~CPU(){
+		jit(false);
+		aot(nullptr);
+#ifdef VM_TRACE
+		tracing(0);
+#endif
+		if (OWN) ram_free(RAM);
+	}
 	void init();
+	bool read(FILE *fp);
+	bool open(const char *path);
+	bool save(const char *path);
+	bool snapshot(const char *path);
+	bool restore(const char *path);
+	CPU *fork();
+	CPU *core(WORD ID);
+	void paging(UINT PAGES);
+	size_t pages() const{
+		return PAGING ? PAGING->committed() : 0;
+	}
+	void attach(BYTE port, Device *dev){
+		DEVICE[port] = dev;
+	}
+	Device *waiting() const{
+		return EXIT == EXIT_WAIT ? WAIT : nullptr;
+	}
 	void load(FILE *fp);
 	void store();
-	void execute();
-	void trace();
+	BYTE execute(UINT BUDGET = BUDGET_ALL);
+	bool verify(FILE *log = nullptr);
+	bool verified() const{
+		return VERIFIED;
+	}
+	BYTE status() const{
+		return EXIT;
+	}
+	UINT cycles() const{
+		return CYCLE;
+	}
+	WORD ip() const{
+		return IP;
+	}
+	void trace(const INST *I);
+	void fusion(UINT MASK);
+	void fusion(string names);
+	void jit(bool on);
+	bool translate(FILE *fp);
+	bool aot(const char *path);
+#ifdef VM_PROFILE
+	void suggest(FILE *fp, int top);
+	void hotspots(FILE *fp, int top);
+	void flamegraph(FILE *fp);
+#endif
+#ifdef VM_TRACE
+	void tracing(size_t SIZE);
+	void dump(FILE *fp);
+#endif
 };
 
+// ֽڵǷ
+string opname(BYTE OP);
+
 #endif
\ No newline at end of file
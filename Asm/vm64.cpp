@@ -0,0 +1,407 @@
+#include "vm64.h"
+#include <stdlib.h>
+#include <string.h>
+
+namespace ISA64{
+
+// ڴеĲֽڶд, Ҫ
+template<typename T> static inline T get(const BYTE *P){
+	T V;
+	memcpy(&V, P, sizeof(T));
+	return V;
+}
+template<typename T> static inline void put(BYTE *P, T V){
+	memcpy(P, &V, sizeof(T));
+}
+// ת, ΧNaNʱx86һõ0x8000000000000000
+static inline U8 toint(F8 V){
+	if (V >= -9223372036854775808.0 && V < 9223372036854775808.0) return (U8)(S8)V;
+	return (U8)1 << 63;
+}
+
+CPU64::CPU64(){
+	memset(R, 0, sizeof(R));
+	memset(RF, 0, sizeof(RF));
+	memset(RD, 0, sizeof(RD));
+	memset(RV, 0, sizeof(RV));
+	IP = SP = 0;
+}
+
+CPU64::~CPU64(){
+	free(RAM);
+}
+
+bool CPU64::open(const char *path){
+	IMAGE64_HEAD H;
+	FILE *fp = fopen(path, "rb");
+	if (!fp){
+		printf("can't open image %s\n", path);
+		return false;
+	}
+	bool OK = fread(&H, sizeof(H), 1, fp) == 1 && H.MAGIC == IMAGE64_MAGIC &&
+		H.VERSION == IMAGE64_VERSION && H.SIZE <= VM64_LIMIT;
+	BYTE *CODE = nullptr;
+	if (OK){
+		CODE = (BYTE*)malloc(H.SIZE ? H.SIZE : 1);
+		OK = CODE && fread(CODE, 1, H.SIZE, fp) == H.SIZE;
+	}
+	fclose(fp);
+	OK = OK && load(CODE, H.SIZE, H.HEAP, H.STACK, H.ENTRY);
+	free(CODE);
+	if (!OK){
+		printf("bad image %s\n", path);
+		return false;
+	}
+	return true;
+}
+
+bool CPU64::load(const BYTE *CODE, U8 SIZE, U8 HEAP, U8 STACK, U8 ENTRY){
+	if (SIZE > VM64_LIMIT || HEAP > VM64_LIMIT || STACK > VM64_LIMIT) return false;
+	U8 TOTAL = SIZE + HEAP + STACK;
+	if (TOTAL > VM64_LIMIT || ENTRY >= SIZE) return false;
+	if (TOTAL < VM64_MIN) TOTAL = VM64_MIN;
+	BYTE *P = (BYTE*)calloc(1, TOTAL + VM64_PAD);
+	if (!P) return false;
+	memcpy(P, CODE, SIZE);
+	free(RAM);
+	RAM = P;
+	this->SIZE = TOTAL;
+	BOTTOM = TOTAL - STACK;
+	SP = TOTAL;
+	IP = ENTRY;
+	memset(R, 0, sizeof(R));
+	memset(RF, 0, sizeof(RF));
+	memset(RD, 0, sizeof(RD));
+	memset(RV, 0, sizeof(RV));
+	INT0 = true;
+	CYCLE = 0;
+	EXIT = EXIT_NONE;
+	WAIT = nullptr;
+	return true;
+}
+
+// INT64_READ/INT64_WRITE: ˿R0ϵ豸ڴ[R1, R1 + R2)֮䴫, ͵ֽдR3
+// 豸δʱfalse, EXITΪEXIT_WAIT; жϺ/˿/ַʱΪEXIT_FAULT
+bool CPU64::interrupt(BYTE N){
+	Device *D = DEVICE[(BYTE)R[0]];
+	U8 ADDR = R[1], LEN = R[2];
+	if ((N != INT64_READ && N != INT64_WRITE) || !D || ADDR > SIZE || LEN > SIZE - ADDR){
+		EXIT = EXIT_FAULT;
+		return false;
+	}
+	size_t K = N == INT64_READ ? D->read(RAM + ADDR, (size_t)LEN) : D->write(RAM + ADDR, (size_t)LEN);
+	if (K == DEVICE_WAIT){
+		WAIT = D;
+		EXIT = EXIT_WAIT;
+		return false;
+	}
+	R[3] = K;
+	return true;
+}
+
+// : CPU::runͬ, GCC/Clangcomputed goto, switch
+// ÿȡָǰPCڴ, ڴĩβ, 11ֽڵָȡԽ
+#define OPND(n)			RAM[PC + n]
+#ifdef VM_THREADED_DISPATCH
+#define OPCASE(op)		L_##op:
+#define OPDEFAULT		L_INVALID:
+#define BIND(op)		TABLE[op] = &&L_##op
+#define NEXT()			if (PC >= SIZE || CYCLE >= LIMIT) goto L_STOP;\
+						CYCLE++;\
+						goto *TABLE[RAM[PC]]
+#define DISPATCH_BEGIN	NEXT();
+#define DISPATCH_END	L_STOP:
+#else
+#define OPCASE(op)		case op:
+#define OPDEFAULT		default:
+#define NEXT()			break
+#define DISPATCH_BEGIN	while (PC < SIZE && CYCLE < LIMIT){\
+							CYCLE++;\
+							switch (RAM[PC]){
+#define DISPATCH_END		}\
+						}
+#endif
+// ʱָִ, IPͣ
+#define STOP(E)			{\
+							CYCLE--;\
+							IP = PC;\
+							EXIT = E;\
+							return EXIT;\
+						}
+#define FAULT()			STOP(EXIT_FAULT)
+// Ĵӷô: ַĴ, дsizeof(T)ֽ
+#define LOADR(op, T, DST)		OPCASE(op)\
+								ADDR = R[OPND(2)];\
+								if (ADDR > SIZE - sizeof(T)) FAULT();\
+								DST[OPND(1)] = get<T>(RAM + ADDR);\
+								PC += 3;\
+								NEXT();
+#define STORER(op, T, SRC)		OPCASE(op)\
+								ADDR = R[OPND(2)];\
+								if (ADDR > SIZE - sizeof(T)) FAULT();\
+								put<T>(RAM + ADDR, (T)SRC[OPND(1)]);\
+								PC += 3;\
+								NEXT();
+#define PUSHR(op, T, SRC)		OPCASE(op)\
+								if (SP < BOTTOM + sizeof(T)) FAULT();\
+								SP -= sizeof(T);\
+								put<T>(RAM + SP, (T)SRC[OPND(1)]);\
+								PC += 2;\
+								NEXT();
+#define POPR(op, T, DST)		OPCASE(op)\
+								if (SP > SIZE - sizeof(T)) FAULT();\
+								DST[OPND(1)] = get<T>(RAM + SP);\
+								SP += sizeof(T);\
+								PC += 2;\
+								NEXT();
+// װĴ, зչ
+#define LOADI(op, T, DST)		OPCASE(op)\
+								DST[OPND(1)] = get<T>(&OPND(2));\
+								PC += 2 + sizeof(T);\
+								NEXT();
+// ͬĴ: һĿ, X/YǺֵ
+#define ARITH(op, REGS, EXPR)	OPCASE(op)\
+								X = REGS[OPND(2)];\
+								Y = REGS[OPND(3)];\
+								REGS[OPND(1)] = EXPR;\
+								PC += 4;\
+								NEXT();
+#define FARITH(op, REGS, EXPR)	OPCASE(op)\
+								{\
+									auto X = REGS[OPND(2)];\
+									auto Y = REGS[OPND(3)];\
+									REGS[OPND(1)] = EXPR;\
+								}\
+								PC += 4;\
+								NEXT();
+// : Ĵ, һĿ
+#define VARITH(op, FN)			OPCASE(op)\
+								FN(RV[OPND(1)], RV[OPND(2)], RV[OPND(3)]);\
+								PC += 4;\
+								NEXT();
+// Ĵ֮Ĵ/ת
+#define UNARY(op, DST, EXPR)	OPCASE(op)\
+								DST[OPND(1)] = EXPR;\
+								PC += 3;\
+								NEXT();
+
+BYTE CPU64::execute(UINT BUDGET){
+	if (!RAM){
+		EXIT = EXIT_FAULT;
+		return EXIT;
+	}
+	LIMIT = BUDGET > ~CYCLE ? ~0u : CYCLE + BUDGET;
+	U8 PC = IP;
+	U8 ADDR, X, Y;
+#ifdef VM_THREADED_DISPATCH
+	void *TABLE[0x100];
+	for (int i = 0; i < 0x100; i++){
+		TABLE[i] = &&L_INVALID;
+	}
+	BIND(LBI); BIND(LWI); BIND(LDI); BIND(LQI); BIND(LF1I); BIND(LF2I);
+	BIND(LAD); BIND(LAI);
+	BIND(LB); BIND(LW); BIND(LD); BIND(LQ); BIND(LF1); BIND(LF2);
+	BIND(SB); BIND(SW); BIND(SD); BIND(SQ); BIND(SF1); BIND(SF2);
+	BIND(PUSHB); BIND(PUSHW); BIND(PUSHD); BIND(PUSHQ); BIND(PUSHF1); BIND(PUSHF2);
+	BIND(POPB); BIND(POPW); BIND(POPD); BIND(POPQ); BIND(POPF1); BIND(POPF2);
+	BIND(MOV); BIND(MOVF); BIND(MOVD);
+	BIND(JMP); BIND(JE); BIND(JNE); BIND(SLT); BIND(INT); BIND(DI); BIND(EI); BIND(HALT); BIND(NOP);
+	BIND(AND); BIND(OR); BIND(XOR); BIND(NOT); BIND(BT); BIND(BS);
+	BIND(SRA); BIND(SRL); BIND(SL);
+	BIND(ADD); BIND(SUB); BIND(MUL); BIND(DIV);
+	BIND(CAST_IF); BIND(CAST_ID); BIND(CAST_FI); BIND(CAST_FD); BIND(CAST_DI); BIND(CAST_DF);
+	BIND(FADD); BIND(FSUB); BIND(FMUL); BIND(FDIV); BIND(FSLT);
+	BIND(DADD); BIND(DSUB); BIND(DMUL); BIND(DDIV); BIND(DSLT);
+	BIND(VLD); BIND(VST); BIND(VMOV); BIND(VBCF); BIND(VBCD);
+	BIND(VFADD); BIND(VFSUB); BIND(VFMUL); BIND(VFMA); BIND(VFLT); BIND(VFSUM);
+	BIND(VDADD); BIND(VDSUB); BIND(VDMUL); BIND(VDFMA); BIND(VDLT); BIND(VDSUM);
+	BIND(VSEL);
+#endif
+	DISPATCH_BEGIN
+	OPCASE(LBI)
+		R[OPND(1)] = (U8)(S8)(S1)OPND(2);
+		PC += 3;
+		NEXT();
+	OPCASE(LWI)
+		R[OPND(1)] = (U8)(S8)get<S2>(&OPND(2));
+		PC += 4;
+		NEXT();
+	OPCASE(LDI)
+		R[OPND(1)] = (U8)(S8)get<S4>(&OPND(2));
+		PC += 6;
+		NEXT();
+	LOADI(LQI, U8, R)
+	LOADI(LF1I, F4, RF)
+	LOADI(LF2I, F8, RD)
+	LOADI(LAD, U8, R)
+	OPCASE(LAI)
+		R[OPND(1)] = R[OPND(2)] + get<U8>(&OPND(3));
+		PC += 11;
+		NEXT();
+	LOADR(LB, S1, R)
+	LOADR(LW, S2, R)
+	LOADR(LD, S4, R)
+	LOADR(LQ, U8, R)
+	LOADR(LF1, F4, RF)
+	LOADR(LF2, F8, RD)
+	STORER(SB, S1, R)
+	STORER(SW, S2, R)
+	STORER(SD, S4, R)
+	STORER(SQ, U8, R)
+	STORER(SF1, F4, RF)
+	STORER(SF2, F8, RD)
+	PUSHR(PUSHB, S1, R)
+	PUSHR(PUSHW, S2, R)
+	PUSHR(PUSHD, S4, R)
+	PUSHR(PUSHQ, U8, R)
+	PUSHR(PUSHF1, F4, RF)
+	PUSHR(PUSHF2, F8, RD)
+	POPR(POPB, S1, R)
+	POPR(POPW, S2, R)
+	POPR(POPD, S4, R)
+	POPR(POPQ, U8, R)
+	POPR(POPF1, F4, RF)
+	POPR(POPF2, F8, RD)
+	UNARY(MOV, R, R[OPND(2)])
+	UNARY(MOVF, RF, RF[OPND(2)])
+	UNARY(MOVD, RD, RD[OPND(2)])
+	// תĿڼĴ, ԽĿ´ȡָʱEXIT_FAULTͣ
+	OPCASE(JMP)
+		PC = R[OPND(1)];
+		NEXT();
+	OPCASE(JE)
+		PC = R[OPND(1)] == R[OPND(2)] ? R[OPND(3)] : PC + 4;
+		NEXT();
+	OPCASE(JNE)
+		PC = R[OPND(1)] != R[OPND(2)] ? R[OPND(3)] : PC + 4;
+		NEXT();
+	ARITH(SLT, R, X < Y ? 1 : 0)
+	OPCASE(INT)
+		if (INT0 && !interrupt(OPND(1))) STOP(EXIT);
+		PC += 2;
+		NEXT();
+	OPCASE(DI)
+		INT0 = false;
+		PC += 1;
+		NEXT();
+	OPCASE(EI)
+		INT0 = true;
+		PC += 1;
+		NEXT();
+	OPCASE(HALT)
+		IP = PC + 1;
+		EXIT = EXIT_HALT;
+		return EXIT;
+	OPCASE(NOP)
+		PC += 1;
+		NEXT();
+	ARITH(AND, R, X & Y)
+	ARITH(OR, R, X | Y)
+	ARITH(XOR, R, X ^ Y)
+	UNARY(NOT, R, ~R[OPND(2)])
+	ARITH(BT, R, X >> (Y & 63) & 1)
+	OPCASE(BS)
+		R[OPND(1)] |= (U8)1 << (R[OPND(2)] & 63);
+		PC += 3;
+		NEXT();
+	// λȡ6λ, x86ͬ
+	ARITH(SRA, R, (U8)((S8)X >> (Y & 63)))
+	ARITH(SRL, R, X >> (Y & 63))
+	ARITH(SL, R, X << (Y & 63))
+	// ޷ĵ64λзͬ, ʱ
+	ARITH(ADD, R, X + Y)
+	ARITH(SUB, R, X - Y)
+	ARITH(MUL, R, X * Y)
+	// DIV $ $ $ $, з; Ϊ0ʱ, Сֵ-1õСֵ0
+	OPCASE(DIV)
+		X = R[OPND(3)];
+		Y = R[OPND(4)];
+		if (Y == 0) FAULT();
+		if (X == (U8)1 << 63 && Y == ~(U8)0){
+			R[OPND(1)] = X;
+			R[OPND(2)] = 0;
+		}else{
+			R[OPND(1)] = (U8)((S8)X / (S8)Y);
+			R[OPND(2)] = (U8)((S8)X % (S8)Y);
+		}
+		PC += 5;
+		NEXT();
+	UNARY(CAST_IF, R, toint(RF[OPND(2)]))
+	UNARY(CAST_ID, R, toint(RD[OPND(2)]))
+	UNARY(CAST_FI, RF, (F4)(S8)R[OPND(2)])
+	UNARY(CAST_FD, RF, (F4)RD[OPND(2)])
+	UNARY(CAST_DI, RD, (F8)(S8)R[OPND(2)])
+	UNARY(CAST_DF, RD, (F8)RF[OPND(2)])
+	FARITH(FADD, RF, X + Y)
+	FARITH(FSUB, RF, X - Y)
+	FARITH(FMUL, RF, X * Y)
+	FARITH(FDIV, RF, X / Y)
+	FARITH(FSLT, RF, X < Y ? 1.0f : 0.0f)
+	FARITH(DADD, RD, X + Y)
+	FARITH(DSUB, RD, X - Y)
+	FARITH(DMUL, RD, X * Y)
+	FARITH(DDIV, RD, X / Y)
+	FARITH(DSLT, RD, X < Y ? 1.0 : 0.0)
+	OPCASE(VLD)
+		ADDR = R[OPND(2)];
+		if (ADDR > SIZE - VEC64_BYTES) FAULT();
+		vload(RV[OPND(1)], RAM + ADDR);
+		PC += 3;
+		NEXT();
+	OPCASE(VST)
+		ADDR = R[OPND(2)];
+		if (ADDR > SIZE - VEC64_BYTES) FAULT();
+		vstore(RAM + ADDR, RV[OPND(1)]);
+		PC += 3;
+		NEXT();
+	UNARY(VMOV, RV, RV[OPND(2)])
+	OPCASE(VBCF)
+		vbroadcast(RV[OPND(1)], RF[OPND(2)]);
+		PC += 3;
+		NEXT();
+	OPCASE(VBCD)
+		vbroadcast(RV[OPND(1)], RD[OPND(2)]);
+		PC += 3;
+		NEXT();
+	VARITH(VFADD, vaddf)
+	VARITH(VFSUB, vsubf)
+	VARITH(VFMUL, vmulf)
+	VARITH(VFMA, vfmaf)
+	VARITH(VFLT, vltf)
+	UNARY(VFSUM, RF, vsumf(RV[OPND(2)]))
+	VARITH(VDADD, vaddd)
+	VARITH(VDSUB, vsubd)
+	VARITH(VDMUL, vmuld)
+	VARITH(VDFMA, vfmad)
+	VARITH(VDLT, vltd)
+	UNARY(VDSUM, RD, vsumd(RV[OPND(2)]))
+	OPCASE(VSEL)
+		vselect(RV[OPND(1)], RV[OPND(2)], RV[OPND(3)], RV[OPND(4)]);
+		PC += 5;
+		NEXT();
+	OPDEFAULT
+		FAULT();
+	DISPATCH_END
+	IP = PC;
+	EXIT = PC >= SIZE ? EXIT_FAULT : EXIT_BUDGET;
+	return EXIT;
+}
+
+void CPU64::dump(FILE *fp){
+	fprintf(fp, "IP %016llx SP %016llx CYCLE %u\n", IP, SP, CYCLE);
+	for (int i = 0; i < 0x100; i++){
+		if (R[i]) fprintf(fp, "$%d = %lld (%016llx)\n", i, (S8)R[i], R[i]);
+	}
+	for (int i = 0; i < 0x100; i++){
+		if (RF[i] != 0) fprintf(fp, "$f%d = %g\n", i, RF[i]);
+	}
+	for (int i = 0; i < 0x100; i++){
+		if (RD[i] != 0) fprintf(fp, "$d%d = %g\n", i, RD[i]);
+	}
+	for (int i = 0; i < 0x100; i++){
+		const U8 *Q = RV[i].Q;
+		if (Q[0] | Q[1] | Q[2] | Q[3]) fprintf(fp, "$v%d = %016llx %016llx %016llx %016llx\n", i, Q[0], Q[1], Q[2], Q[3]);
+	}
+}
+
+}
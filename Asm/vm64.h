@@ -0,0 +1,103 @@
+#ifndef __VM64_H_
+#define __VM64_H_
+
+#include "vm.h"
+#include "inst.h"
+#include "vec64.h"
+
+// 64λӳ: IMAGE64_HEAD֮SIZEֽڵĴ
+// װڴΪ, , ջ; SPڴ涥, ѹջܽ
+#define IMAGE64_MAGIC	0x34364D56	// "VM64"
+#define IMAGE64_VERSION	1
+#define VM64_LIMIT		0x40000000	// ڴ(1G)
+#define VM64_PAD		16			// ڴĩβ, ȡʱԽ
+#define VM64_MIN		64			// ڴô, Ĳֲڶ, ô鲻
+
+// INTжϺ: R0Ϊ˿, R1Ϊַ, R2Ϊֽ, ͵ֽдR3
+#define INT64_READ		0
+#define INT64_WRITE		1
+
+struct IMAGE64_HEAD{
+	U4 MAGIC;
+	U4 VERSION;
+	U8 SIZE;		// ݵֽ
+	U8 HEAP;		// ѵֽ
+	U8 STACK;		// ջֽ
+	U8 ENTRY;		// ڵַ
+};
+
+namespace ISA64{
+
+// 64λָĽ: //˫/Ĵ, Ĵһֽ, 0x100
+// ֱָӴڴȡִ, ֽڲ; ôջԽ, EXIT_FAULTͣ
+class CPU64{
+	U8 R[0x100];
+	F4 RF[0x100];
+	F8 RD[0x100];
+	VREG RV[0x100];
+	U8 IP, SP;
+	BYTE *RAM = nullptr;
+	U8 SIZE = 0;				// ڴֽ()
+	U8 BOTTOM = 0;				// ջ, ѹջܵ
+	bool INT0 = true;			// ΪfalseʱINT(DI/EI)
+	UINT CYCLE = 0;
+	UINT LIMIT = 0;
+	BYTE EXIT = EXIT_NONE;
+	Device *DEVICE[0x100] = {};	// ˿ϵ豸, ɵ
+	Device *WAIT = nullptr;		// EXIT_WAITʱȴ豸
+	bool interrupt(BYTE N);
+public:
+	CPU64();
+	CPU64(const CPU64&) = delete;
+	CPU64 &operator=(const CPU64&) = delete;
+	~CPU64();
+	// ӳļװ
+	bool open(const char *path);
+	// װSIZEֽڵĴ, HEAPֽڵĶѺSTACKֽڵջ, ENTRYʼִ
+	bool load(const BYTE *CODE, U8 SIZE, U8 HEAP, U8 STACK, U8 ENTRY);
+	void attach(BYTE port, Device *dev){
+		DEVICE[port] = dev;
+	}
+	Device *waiting() const{
+		return EXIT == EXIT_WAIT ? WAIT : nullptr;
+	}
+	// ִBUDGETָ, ͣµԭ; EXIT_BUDGET/EXIT_WAITٴεüִ
+	BYTE execute(UINT BUDGET = BUDGET_ALL);
+	BYTE status() const{
+		return EXIT;
+	}
+	UINT cycles() const{
+		return CYCLE;
+	}
+	U8 reg(BYTE N) const{
+		return R[N];
+	}
+	F4 regf(BYTE N) const{
+		return RF[N];
+	}
+	F8 regd(BYTE N) const{
+		return RD[N];
+	}
+	const VREG &regv(BYTE N) const{
+		return RV[N];
+	}
+	U8 ip() const{
+		return IP;
+	}
+	U8 sp() const{
+		return SP;
+	}
+	BYTE *memory(){
+		return RAM;
+	}
+	U8 size() const{
+		return SIZE;
+	}
+	// ӡIP/SPͷļĴ
+	void dump(FILE *fp);
+};
+
+}
+using ISA64::CPU64;
+
+#endif
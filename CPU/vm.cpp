@@ -6,14 +6,14 @@ void CPU::init(){
 	SP = SS;// ջָ
 }
 void CPU::load(string fp){
-	WORD LENGTH = 0;
-	ifstream fout(fp);
+	WORD WORDS = 0;
+	ifstream fout(fp, ios::binary);
 	fout.read((char*)&DS, sizeof(WORD));
 	fout.read((char*)&CS, sizeof(WORD));
-	fout.read((char*)&LENGTH, sizeof(WORD));
-	for (int i = 0; i < LENGTH; i++){
-		fout.read((char*)&RAM[i], sizeof(WORD));
-	}
+	fout.read((char*)&WORDS, sizeof(WORD));
+	// ڴ水ֱַ, WORDSһζ
+	fout.read((char*)RAM, sizeof(WORD) * WORDS);
+	LENGTH = (unsigned int)fout.gcount();
 	fout.close();
 	IP += CS;
 }
@@ -23,7 +23,7 @@ void CPU::execute(){
 	WORD ABUS, DBUS;
 	BYTE TYPE, MR;
 	BYTE OP = RAM[IP++];
-	while (OP != HALT&&IP < 80){
+	while (OP != HALT&&IP <= LENGTH){
 		TYPE = OP & MR_BYTE;
 		MR = OP & MR_B;
 		OP &= (~MR_BYTE);
@@ -39,34 +39,26 @@ void CPU::execute(){
 			if (TYPE == MR_BYTE){
 				ABUS = ReadB();
 				ALU.RA ^= ALU.RA;
-				ALU.RA |= REG[ABUS];
+				ALU.RA |= RegB(ABUS);
 				ABUS = ReadB();
 				ALU.RB ^= ALU.RB;
-				ALU.RB |= REG[ABUS];// λ
+				ALU.RB |= RegB(ABUS);// λ
 				ALU.execute();
 				ABUS = ReadB();
-				REG[ABUS] = ALU.R;// λ
+				RegB(ABUS, ALU.R);// λ
 				cout << "BYTE:" << (int)ALU.R << "=";
 				cout << (int)ALU.RA << " OP " << (int)ALU.RB << endl;
 			}else{
 				ABUS = ReadB();
-				ABUS <<= 1;
 				cout << "ABUS:" << ABUS << ",";
-				ALU.RA ^= ALU.RA;
-				ALU.RA |= REG[ABUS] << 8;// λ
-				ALU.RA |= REG[ABUS + 1];// λ
+				ALU.RA = REG[ABUS];
 				ABUS = ReadB();
-				ABUS <<= 1;
 				cout << "ABUS:" << ABUS << ",";
-				ALU.RB ^= ALU.RB;
-				ALU.RB |= REG[ABUS] << 8;// λ
-				ALU.RB |= REG[ABUS + 1];// λ
+				ALU.RB = REG[ABUS];
 				ALU.execute();
 				ABUS = ReadB();
-				ABUS <<= 1;
 				cout << "ABUS:" << ABUS << endl;
-				REG[ABUS] = ALU.R >> 8;// λ
-				REG[ABUS + 1] = ALU.R;// λ
+				REG[ABUS] = ALU.R;
 				cout << "WORD:" << ALU.R << "=";
 				cout << ALU.RA << " OP " << ALU.RB << endl;
 			}
@@ -91,24 +83,22 @@ void CPU::execute(){
 			ABUS = ReadB();
 			if (TYPE == MR_BYTE){
 				printf("pushb ABUS=%02d SP=%04d\n", ABUS, SP);
-				RAM[SP--] = REG[ABUS];
+				RAM[SP--] = RegB(ABUS);
 			}else{
 				printf("pushw ABUS=%02d SP=%04d\n", ABUS, SP);
-				ABUS <<= 1;
-				RAM[SP--] = REG[ABUS + 1];
-				RAM[SP--] = REG[ABUS];
+				RAM[SP--] = REG[ABUS];// λ
+				RAM[SP--] = REG[ABUS] >> 8;// λ
 			}
 			break;
 		case POP:// RAM[SP]->REG[X]
 			ABUS = ReadB();
 			if (TYPE == MR_BYTE){
 				printf("popb ABUS=%02d SP=%04d\n", ABUS, SP);
-				REG[ABUS] = RAM[SP++];
+				RegB(ABUS, RAM[SP++]);
 			}else{
 				printf("popw ABUS=%02d SP=%04d\n", ABUS, SP);
-				ABUS <<= 1;
-				REG[ABUS] = RAM[SP++];
-				REG[ABUS + 1] = RAM[SP++];
+				REG[ABUS] = RAM[SP++] << 8;// λ
+				REG[ABUS] |= RAM[SP++];// λ
 			}
 			break;
 		case LOAD:// RAM->REG
@@ -119,7 +109,7 @@ void CPU::execute(){
 				case MR_B:DBUS = ReadB(ReadB());  break;
 				default:printf("ERROR %d\n", OP); break;
 				}
-				REG[ABUS] = DBUS;
+				RegB(ABUS, DBUS);
 				printf("loadb %02d %02d\n", ABUS, DBUS);
 			}else{
 				switch (MR){
@@ -127,16 +117,14 @@ void CPU::execute(){
 				case MR_B:DBUS = ReadW(ReadW()); break;
 				default:printf("ERROR %d\n", OP); break;
 				}
-				ABUS <<= 1;
-				REG[ABUS] = DBUS >> 8;
-				REG[ABUS + 1] = DBUS;
+				REG[ABUS] = DBUS;
 				printf("loadw %04d %04d\n", ABUS, DBUS);
 			}
 			break;
 		case STORE:// REG->RAM
 			ABUS = ReadB();
 			if (TYPE == MR_BYTE){
-				DBUS = REG[ABUS];
+				DBUS = RegB(ABUS);
 				switch (MR){
 				case MR_B:ABUS = ReadW(); printf("STORE MR_B WORD "); break;
 				default: printf("error storew"); break;
@@ -144,10 +132,7 @@ void CPU::execute(){
 				RAM[ABUS] = DBUS;
 				printf("%02d %02d\n", ABUS, DBUS);
 			}else{
-				ABUS <<= 1;
-				DBUS ^= DBUS;
-				DBUS |= REG[ABUS] << 8;
-				DBUS |= REG[ABUS + 1];
+				DBUS = REG[ABUS];
 				switch (MR){
 				case MR_B:ABUS = ReadW(); printf("STORE MR_B WORD "); break;
 				default: printf("error storew"); break;
@@ -166,7 +151,9 @@ void CPU::execute(){
 		trace();
 	}
 }
+// : ֻ_DEBUG±, аΪպ
 void CPU::trace(){
+#ifdef _DEBUG
 	char a;
 	cin >> a;
 	cout << "[" << (int)RAM[0];
@@ -189,4 +176,5 @@ void CPU::trace(){
 		}
 		cout << endl;
 	}
+#endif
 }
\ No newline at end of file
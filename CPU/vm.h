@@ -69,12 +69,12 @@ public:
 
 class CPU{
 private:
-	
-	BYTE REG[0x100];
+	alignas(64) WORD REG[0x100];		// Ĵļ, ÿĴһ, ж
 	WORD SP, BP, SI, DI;				// ͨüĴ
 	WORD CS, DS, ES, SS;				// μĴ
 	WORD IN[0x100], OUT[0x100];			// I/O˿
 	WORD IP;							// ָ
+	unsigned int LENGTH = 0;			// װֽ, ִеΪֹ
 	WORD IBUS, DBUS, ABUS;				// ڲ
 	BYTE RAM[0x10000];					// ڴ
 	ALU ALU;							// ALU
@@ -105,6 +105,13 @@ private:
 		RAM[A] = DATA >> 8;
 		RAM[A + 1] = DATA;
 	}
+	// ֽڲ(MR_BYTE)ֻдĴĵֽ
+	BYTE RegB(BYTE R){
+		return (BYTE)REG[R];
+	}
+	void RegB(BYTE R, BYTE DATA){
+		REG[R] = (REG[R] & 0xFF00) | DATA;
+	}
 public:
 	void init();
 	void load(string fp);